@@ -4,8 +4,8 @@
 */
 
 #define VERSION 1
-#define MAJOR_RELEASE 2
-#define MINOR_RELEASE 3
+#define MAJOR_RELEASE 3
+#define MINOR_RELEASE 0
 
 #include <stdio.h>
 #include <time.h>
@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <errno.h>
 
 #ifdef __linux__
@@ -22,6 +23,24 @@
     #include <pthread.h>
     #include <unistd.h>
     #include <dirent.h>
+    #include <spawn.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <linux/fs.h>
+    #include <sys/vfs.h>
+    #include <sys/inotify.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/file.h>
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/stat.h>
+        #include <linux/io_uring.h>
+        #define TINY_IO_URING
+    #endif
 #elif __WIN32
     #define WIN32_LEAN_AND_MEAN
     #define NOGDICAPMASKS     // CC_*, LC_*, PC_*, CP_*, TC_*, RC_
@@ -63,6 +82,7 @@
     #define NOMCX             // Modem Configuration Extensions
     #include <windows.h>
     #include <direct.h>
+    #include <process.h>
 #elif __APPLE__
     #include <sys/time.h>
     #include <sys/types.h>
@@ -71,6 +91,14 @@
     #include <limits.h>
     #include <unistd.h>
     #include <dirent.h>
+    #include <spawn.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/clonefile.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/file.h>
 #else
     #error "Unsupported operating system detected!"
 #endif
@@ -79,6 +107,31 @@
 #define crash(...) {printf("\033[31m[ERROR]\033[0m "); print(__VA_ARGS__);exit(1);}
 #define warn(...) {printf("\033[33m[WARNING]\033[0m "); print(__VA_ARGS__);}
 #define PATHLEN 4096
+#define MANIFEST_PATH "build/cache/tiny.manifest"
+#define MANIFEST_VERSION 2
+#define UNITY_BATCH_FILES 16
+#define STORE_PATH "build/store"
+#define CACHE_ARCHIVE_VERSION 1
+#define ARENA_BLOCK_SIZE 65536
+#define MAP_THRESHOLD 65536
+#define COPY_BUFFER_SIZE 65536
+#define INVENTORY_PATH "build/cache/tiny.inventory"
+#define INVENTORY_VERSION 1
+#define INVENTORY_RACY_WINDOW 2000000000ULL
+#define STAT_RING_DEPTH 256
+#define STAT_RING_MINIMUM 64
+#define STATE_PATH "build/cache/tiny.state"
+#define STATE_VERSION 1
+#define WATCH_SETTLE_MS 100
+#define WATCH_POLL_MS 500
+#define DAEMON_SOCKET "build/tiny.sock"
+#define DAEMON_VERSION 1
+#define DAEMON_REFUSED -1
+#define DAEMON_RESTART -2
+#define DAEMON_TIMEOUT_MS 5000
+#define LOCK_PATH "build/tiny.lock"
+#define PROFILE_PATH "build/compile-profile.txt"
+#define PROFILE_PHASES 8
 
 #ifdef __linux__
     #define PATH_SEP '/'
@@ -95,6 +148,7 @@
     #define TINY_WAIT_COND(cond, mutex) pthread_cond_wait(&cond, &mutex)
     #define TINY_SIGNAL_COND(cond) pthread_cond_signal(&cond)
     #define TINY_BROADCAST_COND(cond) pthread_cond_broadcast(&cond)
+    #define TINY_SLEEP(ms) usleep((ms) * 1000)
 #elif __WIN32
     #define PATH_SEP '\\'
     #define cwd(buffer) _getcwd(buffer, sizeof(buffer))
@@ -110,6 +164,7 @@
     #define TINY_WAIT_COND(cond, mutex) SleepConditionVariableCS(&cond, &mutex, INFINITE);
     #define TINY_SIGNAL_COND(cond) WakeConditionVariable(&cond)
     #define TINY_BROADCAST_COND(cond) WakeAllConditionVariable(&cond)
+    #define TINY_SLEEP(ms) Sleep(ms)
 #elif __APPLE__
     #define PATH_SEP '/'
     #define cwd(buffer) getcwd(buffer, sizeof(buffer))
@@ -125,6 +180,7 @@
     #define TINY_WAIT_COND(cond, mutex) pthread_cond_wait(&cond, &mutex)
     #define TINY_SIGNAL_COND(cond) pthread_cond_signal(&cond)
     #define TINY_BROADCAST_COND(cond) pthread_cond_broadcast(&cond)
+    #define TINY_SLEEP(ms) usleep((ms) * 1000)
 #else
     #error "Unsupported operating system detected!"
 #endif
@@ -139,16 +195,27 @@ typedef enum {
     DEBUG = 1 << 3,
     RECOMPILE_VENDORS = 1 << 4,
     RUN = 1 << 5,
-    CLEAN = 1 << 6
+    CLEAN = 1 << 6,
+    UNITY = 1 << 7,
+    WATCH = 1 << 8,
+    DAEMON = 1 << 9,
+    PROFILE = 1 << 10
 } BuildFlags;
 
 typedef struct {
-    char str[PATHLEN];
+    char* data;
+    size_t used;
+    size_t capacity;
+    void* next;
+} ArenaBlock;
+
+typedef struct {
+    const char* str;
     void* next;
 } PathList;
 
 typedef struct {
-    char header[PATHLEN];
+    const char* header;
     PathList* links;
     PathList* secondaries;
 } HeaderLink;
@@ -159,13 +226,72 @@ typedef struct {
 } HeaderLinkList;
 
 typedef struct {
-    char* command;
-    char destination[PATHLEN];
+    char** argv;
+    size_t count;
+    size_t capacity;
+    size_t borrowed;
+} ArgList;
+
+typedef struct {
+    int exited;
+    int code;
+    int signal;
+} ProcessResult;
+
+typedef struct {
+    const char* path;
+    uint64_t size;
+    uint64_t mtime;
+} CacheFile;
+
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t* lines;
+    size_t line_count;
+    int mapped;
+} FileView;
+
+typedef struct {
+    ArgList* command;
     char file[PATHLEN];
-    int index;
+    char object[PATHLEN];
+    char depfile[PATHLEN];
+    void* entry;
     int basename_ptr;
     int sourcei;
-} ThreadParameters;
+    int pch;
+    int lane;
+    uint64_t queued;
+    void* next;
+} CompileJob;
+
+typedef struct {
+    const char* name;
+    const char* category;
+    const char* file;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t queued;
+    int lane;
+    int cached;
+} TraceEvent;
+
+typedef struct {
+    const char* file;
+    uint64_t wall;
+    double total;
+    double phases[PROFILE_PHASES];
+} ProfileUnit;
+
+typedef struct {
+    uint64_t bytes;
+    size_t units;
+    size_t direct;
+    size_t last_unit;
+    size_t last_direct;
+    double parse;
+} ProfileHeader;
 
 typedef struct {
     char name[PATHLEN];
@@ -179,34 +305,105 @@ typedef struct {
     void* next;
 } ModuleList;
 
+typedef struct {
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t inode;
+} FileStats;
+
+typedef struct {
+    const char* key;
+    void* value;
+} HashEntry;
+
+typedef struct {
+    HashEntry* entries;
+    size_t capacity;
+    size_t count;
+} HashMap;
+
+typedef enum {
+    MANIFEST_UNKNOWN = 0,
+    MANIFEST_UNCHANGED = 1,
+    MANIFEST_CHANGED = 2
+} ManifestStatus;
+
+typedef struct {
+    FileStats stats;
+    uint64_t hash;
+    FileStats current;
+    uint64_t current_hash;
+    PathList* deps;
+    int recorded;
+    int tracked;
+    int prefetched;
+    ManifestStatus status;
+} ManifestEntry;
+
+typedef struct {
+    uint64_t mtime;
+    PathList* files;
+    PathList* dirs;
+    int scanned;
+} InventoryDir;
+
 #ifdef __linux__
     typedef pthread_t TINY_THREAD;
     typedef pthread_mutex_t TINY_MUTEX;
     typedef pthread_cond_t TINY_COND;
+    typedef pid_t TINY_PROCESS;
+    typedef int TINY_FILE;
 #elif __WIN32
     typedef HANDLE TINY_THREAD;
     typedef CRITICAL_SECTION TINY_MUTEX;
     typedef CONDITION_VARIABLE TINY_COND;
+    typedef HANDLE TINY_PROCESS;
+    typedef HANDLE TINY_FILE;
 #elif __APPLE__
     typedef pthread_t TINY_THREAD;
     typedef pthread_mutex_t TINY_MUTEX;
     typedef pthread_cond_t TINY_COND;
+    typedef pid_t TINY_PROCESS;
+    typedef int TINY_FILE;
 #else
     #error "Unsupported operating system detected!"
 #endif
 
 void run_build();
+void launch_build();
+void stop_build();
+void restart_self(char* argv[]);
+void add_watch(const char* dir);
+void watch_wait(int argc, char* argv[]);
+int daemon_connect();
+int daemon_forward(int argc, char* argv[]);
+int daemon_listen();
+void daemon_serve(int argc, char* argv[]);
+void build_lock();
+void build_unlock();
 int make_symlink(const char* src, const char* dest);
 int copytree(const char* src, const char* dest);
 void rmtree(const char* path);
 char* generate_quote(const char* s);
 int runcmd(const char* cmd);
+int spawnprocess(char* const argv[], const char* output, const char* errors, ProcessResult* result);
 int threadcount();
+double loadaverage();
 int dexists(const char* dir);
 int fexists(const char* file);
+int filestats(const char* file, FileStats* stats);
+int dirmtime(const char* dir, uint64_t* mtime);
+void filestats_batch(const char** files, FileStats* stats, int* found, size_t count);
+int listdir(const char* path, PathList** files, PathList** dirs);
+int replacefile(const char* src, const char* dst);
+int touchfile(const char* file);
+const char* mapfile(const char* file, size_t* size, int* mapped);
+void unmapfile(const char* data, size_t size, int mapped);
+void copyfile(const char* src, const char* dst);
 void walkdir(const char* path, FileHandler func);
 void walkfiles(const char* path, FileHandler func);
 uint64_t mtime();
+uint64_t microtime();
 void dissect_time_elapsed(uint64_t time, int* hours, int* minutes, float* seconds);
 void integrate_modules();
 void dissect_module(const char* str);
@@ -214,10 +411,24 @@ void download_module(const char* name, const char* url, const char* path);
 int rmakedir(const char* dir);
 void modulelist_add(ModuleList** list, Module module);
 void modulelist_delete(ModuleList* list);
+void* arena_alloc(size_t size);
+const char* intern(const char* str);
+size_t internlen(const char* str);
+FileView* fileview(const char* path);
+int fileview_line(FileView* view, size_t index, char* line, size_t size);
+uint64_t hashview(const char* path);
+void fileviews_close();
 void pathlist_add(PathList** list, const char* path);
 void pathlist_delete(PathList* list);
 size_t pathlist_len(PathList* list);
-void pathlist_construct(PathList* list, char* output);
+void arglist_add(ArgList* args, const char* arg);
+void arglist_extend(ArgList* args, PathList* list, int split);
+void arglist_split(ArgList* args, const char* str);
+void arglist_unquote(char* buffer, const char* str, size_t size);
+void arglist_delete(ArgList* args);
+ArgList* arglist_template(ArgList* template);
+char* arglist_render(ArgList* args);
+int runprocess(ArgList* args, const char* name, const char* output, const char* errors);
 void clean_header_links();
 void clean_source_links();
 int header_link_exists(const char* header);
@@ -229,27 +440,102 @@ int functionimplline(const char* line);
 int vardeclared(const char* line);
 void easyc_audit(const char* file);
 void syntax_audit(const char* file);
-void copyfile(const char* src, const char* dst);
-int filecmp(const char* path1, const char* path2);
+uint64_t fnv1a(const void* data, size_t len, uint64_t hash);
+uint64_t hashfile(const char* path);
+uint64_t fnv1a_relocated(const char* data, size_t len, const char* prefix, uint64_t hash);
+uint64_t hashfile_relocated(const char* path, const char* prefix, uint64_t hash);
+void* hashmap_get(HashMap* map, const char* key);
+void hashmap_put(HashMap* map, const char* key, void* value);
+void hashmap_clear(HashMap* map, int free_values);
+ManifestEntry* manifest_entry(const char* path);
+int manifest_changed(const char* path);
+void manifest_commit(ManifestEntry* entry);
+int manifest_stale(const char* path);
+void manifest_track(ManifestEntry* entry, const char* depfile);
+char* normalize_path(const char* path, char* output);
+PathList* parse_depfile(const char* path);
+void manifest_load();
+void manifest_save();
+void manifest_settle();
+void manifest_prefetch();
+InventoryDir* inventory_dir(const char* path);
+void inventory_load();
+void inventory_save();
+void inventory_scan(const char* path);
+void inventory_build();
+void inventory_walk(const char* path, FileHandler dirfunc, FileHandler filefunc);
+void watch_file(const char* path);
+void watch_directory(const char* path);
+uint64_t state_signature(int argc, char* argv[]);
+int state_current(int argc, char* argv[], unsigned* flags);
+int state_fresh(int argc, char* argv[]);
+void state_save(int argc, char* argv[]);
 void affirmdir(const char* dir);
 void affirm_to_cache(const char* dir);
 void add_to_sources(const char* file);
-void verify_header(const char* file);
-void accumulate_header(const char* file);
 void async_compile_progress_update(int index, int action, const char* name);
-void async_compile(void* params);
+uint64_t compiler_hash();
+uint64_t store_key(CompileJob* job, const char* preprocessed, const char* errors);
+void store_path(uint64_t key, const char* extension, char* output);
+void dumpfile(const char* path);
+void async_compile(CompileJob* job);
+void compile_worker(void* params);
+void pool_start();
+void pool_submit(CompileJob* job);
+void pool_wait();
+void pool_stop();
 void compile_source(const char* file);
+void compile_unit(const char* file, const char* object, int vendor);
+ArgList* base_template();
+ArgList* compile_template(int vendor);
+void object_path(const char* root, const char* file, char* output);
+int valueflag(const char* flag);
 void parseflag(char* flag, int blacklistable);
 void configure(const char* prepath, const char* path);
 void affirm_projects();
-void initialize(int argc, char* argv[]);
+void parseflags(int argc, char* argv[]);
+void initialize();
 void compile_vendors();
+void compile_pch();
+int compare_paths(const void* a, const void* b);
+void compile_unity();
+void add_dependent(const char* header, const char* source);
 void calculate_dependencies();
 void compile_objects();
 void compile_executable();
 void get_in_depth_headers(const char* dive_header, HeaderLinkList* update_header);
 void audit();
 void port_folder(const char* path);
+void prepare();
+uint64_t flag_signature();
+void add_to_archive(const char* file);
+int archive_member(const char* path);
+void cache_export(const char* path);
+void cache_import(const char* path);
+uint64_t parsesize(const char* value);
+void add_live_object(const char* file);
+void add_to_cache_files(const char* file);
+int compare_cache_files(const void* a, const void* b);
+void cache_gc();
+void cache_command(int argc, char* argv[]);
+void build(int argc, char* argv[]);
+void reset_build();
+int config_changed();
+void watch_targets(FileHandler func);
+void watch(int argc, char* argv[]);
+uint64_t request_signature(int argc, char* argv[]);
+void manifest_reload();
+int daemon_request(int argc, char* argv[], int request_argc, char* request_argv[]);
+TraceEvent* trace_push();
+void trace_phase(const char* name, uint64_t start);
+void trace_job(CompileJob* job, uint64_t start, int cached);
+void trace_string(FILE* fp, const char* str);
+void trace_write();
+int profile_phase(const char* name);
+void profile_collect(CompileJob* job, const char* log, uint64_t duration);
+int compare_profile_units(const void* a, const void* b);
+int compare_profile_headers(const void* a, const void* b);
+void profile_write();
 
 size_t s_start_time = 0;
 BuildFlags s_flags = NONE;
@@ -257,10 +543,13 @@ BuildFlags s_unflags = NONE;
 char s_main_file_name[PATHLEN];
 int s_found_main = 0;
 int s_sources_up_to_date = 1;
-int s_main_up_to_date = 1;
+int s_main_scheduled = 0;
 int s_vulnerabilities = 0;
 char s_main_file_path[PATHLEN] = { 0 };
+char s_pch_header[PATHLEN] = { 0 };
+char s_pch_stub[PATHLEN] = { 0 };
 char s_cwd[PATHLEN] = { 0 };
+char s_prefix_map[PATHLEN + 24] = { 0 };
 PathList* s_projects = NULL;
 PathList* s_includes = NULL;
 PathList* s_links = NULL;
@@ -269,22 +558,85 @@ PathList* s_defines = NULL;
 PathList* s_libs = NULL;
 PathList* s_sources = NULL;
 PathList* s_objects = NULL;
+PathList* s_unity_sources = NULL;
 PathList* s_changed_headers = NULL;
+HashMap s_dependents = { 0 };
+HashMap s_dirty = { 0 };
+PathList* s_pending_headers = NULL;
+HashMap s_manifest = { 0 };
+HashMap s_inventory = { 0 };
+int s_inventory_ready = 0;
+int s_inventory_dirty = 0;
+HashMap s_watched_files = { 0 };
+HashMap s_watched_dirs = { 0 };
+TINY_PROCESS s_run_process = 0;
+int s_watch_fd = -1;
+int s_build_failed = 0;
+int s_relinked = 0;
+FileStats s_daemon_manifest = { 0 };
+int s_daemon_fd = -1;
+TINY_FILE s_build_lock;
+int s_build_locked = 0;
+char s_trace_path[PATHLEN] = { 0 };
+TraceEvent* s_trace_events = NULL;
+size_t s_trace_count = 0;
+size_t s_trace_capacity = 0;
+uint64_t s_trace_start = 0;
+TINY_MUTEX s_trace_mutex;
+ProfileUnit* s_profile_units = NULL;
+size_t s_profile_count = 0;
+size_t s_profile_capacity = 0;
+const char* s_profile_phases[PROFILE_PHASES] = { 0 };
+HashMap s_profile_headers = { 0 };
 HeaderLinkList* s_header_links = NULL;
 HeaderLinkList* s_source_links = NULL;
 TINY_THREAD* s_threads = NULL;
-int* s_active_threads = NULL;
+int s_thread_count = 0;
+int s_jobs = 0;
+int s_jobs_running = 0;
+double s_load_limit = 0;
+CompileJob* s_job_queue = NULL;
+CompileJob* s_job_queue_tail = NULL;
+int s_jobs_pending = 0;
+int s_pool_closing = 0;
 TINY_MUTEX s_mutex;
+TINY_MUTEX s_arena_mutex;
+ArenaBlock* s_arena = NULL;
+const char** s_interned = NULL;
+size_t s_interned_count = 0;
+size_t s_interned_capacity = 0;
+PathList* s_free_nodes = NULL;
+TINY_MUTEX s_view_mutex;
+HashMap s_views = { 0 };
+ArgList* s_base_template = NULL;
+ArgList* s_compile_templates[2] = { NULL, NULL };
+TINY_COND s_job_cond;
+TINY_COND s_done_cond;
 int s_sourcei = 0;
+uint64_t s_compiler_hash = 0;
 int s_easymemory_detected = 0;
 ModuleList* s_modules = NULL;
+PathList* s_archive_files = NULL;
+PathList* s_cache_files = NULL;
+HashMap s_live_objects = { 0 };
+uint64_t s_cache_limit = 0;
 char** s_copy_argsv = NULL;
 int s_copy_argsc = 0;
 int s_max_argsc = 0;
 
 #ifdef __linux__
     void run_build() {
+        launch_build();
+        int status;
+        if (waitpid(s_run_process, &status, 0) < 0) {
+            crash("Unable to wait on executable cleanup");
+        }
+        s_run_process = 0;
+    }
+
+    void launch_build() {
         affirmdir("build/env");
+        fflush(stdout);
         pid_t pid = fork();
         if (pid < 0) {
             crash("Fork error");
@@ -297,10 +649,239 @@ int s_max_argsc = 0;
             execv("../bin.exe", s_copy_argsv);
             crash("Unable to run executable");
         }
-        int status;
-        if (waitpid(pid, &status, 0) < 0) {
-            crash("Unable to wait on executable cleanup");
+        s_run_process = pid;
+    }
+
+    void stop_build() {
+        if (s_run_process <= 0) return;
+        kill(s_run_process, SIGTERM);
+        for (int i = 0; i < 10 && waitpid(s_run_process, NULL, WNOHANG) == 0; i++) {
+            if (i == 9) {
+                kill(s_run_process, SIGKILL);
+                waitpid(s_run_process, NULL, 0);
+            } else {
+                TINY_SLEEP(100);
+            }
+        }
+        s_run_process = 0;
+    }
+
+    void restart_self(char* argv[]) {
+        fflush(stdout);
+        execvp(argv[0], argv);
+        crash("Unable to restart \"%s\"", argv[0]);
+    }
+
+    int daemon_connect() {
+        struct sockaddr_un address = { 0 };
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, DAEMON_SOCKET, sizeof(address.sun_path) - 1);
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) return -1;
+        if (connect(server, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            close(server);
+            return -1;
+        }
+        return server;
+    }
+
+    int daemon_forward(int argc, char* argv[]) {
+        int server = daemon_connect();
+        if (server < 0) return DAEMON_REFUSED;
+        char header[64] = { 0 };
+        int length = snprintf(header, sizeof(header), "TINY REQUEST %d %d\n", DAEMON_VERSION, argc);
+        int sent = write(server, header, length) == length;
+        for (int i = 0; i < argc && sent; i++) {
+            sent = write(server, argv[i], strlen(argv[i]) + 1) == (ssize_t)(strlen(argv[i]) + 1);
+        }
+        if (!sent) {
+            close(server);
+            return DAEMON_REFUSED;
+        }
+        shutdown(server, SHUT_WR);
+        // output streams back verbatim until a NUL, followed by the build status and whether to run
+        char buffer[4096];
+        char trailer[2] = { 0, 0 };
+        int trailing = -1;
+        ssize_t count = 0;
+        while (trailing < 2 && (count = read(server, buffer, sizeof(buffer))) > 0) {
+            char* cursor = buffer;
+            if (trailing < 0) {
+                char* end = memchr(buffer, '\0', count);
+                fwrite(buffer, 1, end ? end - buffer : count, stdout);
+                if (end == NULL) continue;
+                trailing = 0;
+                cursor = end + 1;
+            }
+            while (cursor < buffer + count && trailing < 2) trailer[trailing++] = *cursor++;
+        }
+        close(server);
+        fflush(stdout);
+        if (trailer[0] == 'R') return DAEMON_REFUSED;
+        // the restarted daemon keeps the socket, so the retry queues behind its first build
+        if (trailer[0] == 'S') return daemon_forward(argc, argv);
+        if (trailing < 2 || (trailer[0] != '0' && trailer[0] != '1')) {
+            print("Lost connection to the build daemon");
+            return 1;
+        }
+        if (trailer[1] == 'r' && !(s_flags & RUN)) {
+            char run[] = "-r";
+            parseflag(run, 0);
+        }
+        return trailer[0] - '0';
+    }
+
+    int daemon_listen() {
+        // a restarting daemon hands its socket down so queued clients are not dropped
+        const char* inherited = getenv("TINY_DAEMON_FD");
+        if (inherited != NULL) {
+            int server = atoi(inherited);
+            unsetenv("TINY_DAEMON_FD");
+            fcntl(server, F_SETFD, FD_CLOEXEC);
+            return server;
+        }
+        int server = daemon_connect();
+        if (server >= 0) {
+            close(server);
+            crash("A build daemon is already serving this project");
+        }
+        affirmdir("build");
+        struct sockaddr_un address = { 0 };
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, DAEMON_SOCKET, sizeof(address.sun_path) - 1);
+        remove(DAEMON_SOCKET);
+        server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0 || fcntl(server, F_SETFD, FD_CLOEXEC) != 0 ||
+            bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0) {
+            crash("Unable to open the build daemon socket \"%s\"", DAEMON_SOCKET);
+        }
+        return server;
+    }
+
+    void daemon_serve(int argc, char* argv[]) {
+        // clients that hang up mid-build must not take the daemon down with them
+        signal(SIGPIPE, SIG_IGN);
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        print("Serving builds on \"%s\"...", DAEMON_SOCKET);
+        size_t capacity = PATHLEN;
+        char* request = malloc(capacity);
+        while (1) {
+            int client = accept(s_daemon_fd, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                crash("Unable to accept build daemon clients");
+            }
+            fcntl(client, F_SETFD, FD_CLOEXEC);
+            // a client that never finishes its request must not hold up everyone queued behind it
+            struct timeval timeout = { DAEMON_TIMEOUT_MS / 1000, (DAEMON_TIMEOUT_MS % 1000) * 1000 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            size_t size = 0;
+            ssize_t count = 0;
+            while ((count = read(client, request + size, capacity - size - 1)) > 0) {
+                size += count;
+                if (size + 1 == capacity) {
+                    capacity *= 2;
+                    request = realloc(request, capacity);
+                }
+            }
+            if (count < 0) {
+                warn("Dropped a build daemon client that did not finish its request");
+                close(client);
+                continue;
+            }
+            request[size] = '\0';
+            int version = 0;
+            int request_argc = 0;
+            int offset = 0;
+            char* request_argv[PATHLEN / 4];
+            if (sscanf(request, "TINY REQUEST %d %d\n%n", &version, &request_argc, &offset) != 2 || offset == 0 ||
+                version != DAEMON_VERSION || request_argc <= 0 || request_argc > PATHLEN / 4) {
+                close(client);
+                continue;
+            }
+            char* cursor = request + offset;
+            for (int i = 0; i < request_argc; i++) {
+                request_argv[i] = cursor < request + size ? cursor : "";
+                cursor += strlen(cursor) + 1;
+            }
+            // compiler diagnostics and the linker write to stderr, so both streams go to the client
+            fflush(stdout);
+            fflush(stderr);
+            int console = dup(STDOUT_FILENO);
+            int errors = dup(STDERR_FILENO);
+            dup2(client, STDOUT_FILENO);
+            dup2(client, STDERR_FILENO);
+            int status = daemon_request(argc, argv, request_argc, request_argv);
+            fflush(stdout);
+            fflush(stderr);
+            dup2(console, STDOUT_FILENO);
+            dup2(errors, STDERR_FILENO);
+            close(console);
+            close(errors);
+            char trailer[3] = { '\0', status == DAEMON_REFUSED ? 'R' : status == DAEMON_RESTART ? 'S' : '0' + status, s_flags & RUN ? 'r' : '-' };
+            if (write(client, trailer, sizeof(trailer)) != sizeof(trailer)) {
+                warn("Build daemon client hung up before the build finished");
+            }
+            close(client);
+            if (status == DAEMON_RESTART) {
+                print("Restarting the build daemon...");
+                char inherited[32] = { 0 };
+                snprintf(inherited, sizeof(inherited), "%d", s_daemon_fd);
+                setenv("TINY_DAEMON_FD", inherited, 1);
+                fcntl(s_daemon_fd, F_SETFD, 0);
+                restart_self(argv);
+            }
+            print("Served a build request - %s", status == DAEMON_REFUSED ? "refused" : status == 0 ? "\033[32msucceeded\033[0m" : "\033[31mfailed\033[0m");
+        }
+    }
+
+    void build_lock() {
+        if (s_build_locked) return;
+        // local builds, watchers and the daemon all share build/, so only one of them may build at a time,
+        // the lock lives outside build/cache so cleaning or importing the cache cannot delete it
+        affirmdir("build");
+        s_build_lock = open(LOCK_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (s_build_lock < 0) {
+            crash("Unable to open the build lock \"%s\"", LOCK_PATH);
+        }
+        if (flock(s_build_lock, LOCK_EX | LOCK_NB) != 0) {
+            print("Waiting for another build of this project to finish...");
+            while (flock(s_build_lock, LOCK_EX) != 0) {
+                if (errno != EINTR) crash("Unable to take the build lock \"%s\"", LOCK_PATH);
+            }
+        }
+        s_build_locked = 1;
+    }
+
+    void build_unlock() {
+        if (!s_build_locked) return;
+        close(s_build_lock);
+        s_build_locked = 0;
+    }
+
+    void add_watch(const char* dir) {
+        inotify_add_watch(s_watch_fd, dir, IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+    }
+
+    void watch_wait(int argc, char* argv[]) {
+        if (s_watch_fd < 0) {
+            s_watch_fd = inotify_init1(IN_CLOEXEC);
+            if (s_watch_fd < 0) {
+                crash("Unable to watch the project for changes");
+            }
         }
+        watch_targets(add_watch);
+        char events[4096];
+        do {
+            if (read(s_watch_fd, events, sizeof(events)) < 0 && errno != EINTR) {
+                crash("Unable to read file change events");
+            }
+            // editors save in bursts, so let the tree settle before rebuilding
+            struct pollfd pending = { s_watch_fd, POLLIN, 0 };
+            while (poll(&pending, 1, WATCH_SETTLE_MS) > 0) {
+                if (read(s_watch_fd, events, sizeof(events)) < 0) break;
+            }
+        } while (state_current(argc, argv, NULL));
     }
 
     int make_symlink(const char* src, const char* dest) {
@@ -356,10 +937,38 @@ int s_max_argsc = 0;
         return -1;
     }
 
+    int spawnprocess(char* const argv[], const char* output, const char* errors, ProcessResult* result) {
+        extern char** environ;
+        pid_t pid;
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (output) posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (errors) posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, errors, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int spawned = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ) == 0;
+        posix_spawn_file_actions_destroy(&actions);
+        if (!spawned) {
+            return 0;
+        }
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) return 0;
+        }
+        result->exited = WIFEXITED(status);
+        result->code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        result->signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+        return 1;
+    }
+
     int threadcount() {
         return (int)sysconf(_SC_NPROCESSORS_ONLN);
     }
 
+    double loadaverage() {
+        double load[1] = { 0 };
+        if (getloadavg(load, 1) != 1) return 0;
+        return load[0];
+    }
+
     int dexists(const char* dir) {
         struct stat statbuf;
         if (stat(dir, &statbuf) != 0) {
@@ -376,6 +985,258 @@ int s_max_argsc = 0;
         return !S_ISDIR(statbuf.st_mode);
     }
 
+    int filestats(const char* file, FileStats* stats) {
+        struct stat statbuf;
+        if (stat(file, &statbuf) != 0 || S_ISDIR(statbuf.st_mode)) {
+            return 0;
+        }
+        stats->size = (uint64_t)statbuf.st_size;
+        stats->mtime = (uint64_t)statbuf.st_mtim.tv_sec * 1000000000 + (uint64_t)statbuf.st_mtim.tv_nsec;
+        stats->inode = (uint64_t)statbuf.st_ino;
+        return 1;
+    }
+    int dirmtime(const char* dir, uint64_t* mtime) {
+        struct stat statbuf;
+        if (stat(dir, &statbuf) != 0 || !S_ISDIR(statbuf.st_mode)) {
+            return 0;
+        }
+        *mtime = (uint64_t)statbuf.st_mtim.tv_sec * 1000000000 + (uint64_t)statbuf.st_mtim.tv_nsec;
+        return 1;
+    }
+    int networkfs(const char* path) {
+        static const uint32_t remote[] = { 0x6969, 0x517B, 0xFF534D42, 0xFE534D42, 0x00C36400, 0x65735546, 0x5346414F, 0x01021997 };
+        struct statfs info;
+        if (statfs(path, &info) != 0) return 0;
+        for (size_t i = 0; i < sizeof(remote) / sizeof(remote[0]); i++) {
+            if ((uint32_t)info.f_type == remote[i]) return 1;
+        }
+        return 0;
+    }
+    #ifdef TINY_IO_URING
+    int statx_ring(const char** files, FileStats* stats, int* found, size_t count) {
+        struct io_uring_params params = { 0 };
+        unsigned depth = count < STAT_RING_DEPTH ? (unsigned)count : STAT_RING_DEPTH;
+        int ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+        if (ring < 0) return 0;
+        int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (single && cq_size > sq_size) sq_size = cq_size;
+        size_t sqe_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        char* sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        char* cq = single ? sq : mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        struct io_uring_sqe* sqes = mmap(NULL, sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sq != MAP_FAILED) munmap(sq, sq_size);
+            if (!single && cq != MAP_FAILED) munmap(cq, cq_size);
+            if (sqes != MAP_FAILED) munmap(sqes, sqe_size);
+            close(ring);
+            return 0;
+        }
+        unsigned* sq_tail = (unsigned*)(sq + params.sq_off.tail);
+        unsigned sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+        unsigned* sq_array = (unsigned*)(sq + params.sq_off.array);
+        unsigned* cq_head = (unsigned*)(cq + params.cq_off.head);
+        unsigned* cq_tail = (unsigned*)(cq + params.cq_off.tail);
+        unsigned cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+        struct io_uring_cqe* cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+        struct statx* buffers = malloc(depth * sizeof(struct statx));
+        size_t done = 0;
+        while (done < count) {
+            unsigned batch = count - done < depth ? (unsigned)(count - done) : depth;
+            unsigned tail = *sq_tail;
+            for (unsigned i = 0; i < batch; i++) {
+                unsigned slot = (tail + i) & sq_mask;
+                struct io_uring_sqe* sqe = &sqes[slot];
+                memset(sqe, 0, sizeof(struct io_uring_sqe));
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uint64_t)(uintptr_t)files[done + i];
+                sqe->len = STATX_BASIC_STATS;
+                sqe->off = (uint64_t)(uintptr_t)&buffers[i];
+                sqe->user_data = i;
+                sq_array[slot] = slot;
+            }
+            __atomic_store_n(sq_tail, tail + batch, __ATOMIC_RELEASE);
+            unsigned reaped = 0;
+            unsigned waiting = batch;
+            while (reaped < batch) {
+                if (syscall(__NR_io_uring_enter, ring, waiting, batch - reaped, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                waiting = 0;
+                unsigned head = *cq_head;
+                unsigned ready = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                for (; head != ready; head++) {
+                    struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+                    size_t index = done + cqe->user_data;
+                    struct statx* buffer = &buffers[cqe->user_data];
+                    if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+                        found[index] = filestats(files[index], &stats[index]);
+                    } else if (cqe->res < 0 || S_ISDIR(buffer->stx_mode)) {
+                        found[index] = 0;
+                    } else {
+                        stats[index].size = buffer->stx_size;
+                        stats[index].mtime = (uint64_t)buffer->stx_mtime.tv_sec * 1000000000 + (uint64_t)buffer->stx_mtime.tv_nsec;
+                        stats[index].inode = buffer->stx_ino;
+                        found[index] = 1;
+                    }
+                    reaped++;
+                }
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            }
+            if (reaped < batch) {
+                // statx still queued in io-wq can land after teardown, so the
+                // buffers have to outlive the ring and are leaked on this path
+                buffers = NULL;
+                break;
+            }
+            done += batch;
+        }
+        free(buffers);
+        munmap(sqes, sqe_size);
+        if (!single) munmap(cq, cq_size);
+        munmap(sq, sq_size);
+        close(ring);
+        for (; done < count; done++) {
+            found[done] = filestats(files[done], &stats[done]);
+        }
+        return 1;
+    }
+    #endif
+    void filestats_batch(const char** files, FileStats* stats, int* found, size_t count) {
+        #ifdef TINY_IO_URING
+        // queued statx only pays off when every lookup is a round trip, on local disks
+        // the worker handoff costs more than the stat itself
+        if (count >= STAT_RING_MINIMUM && networkfs(".") && statx_ring(files, stats, found, count)) return;
+        #endif
+        for (size_t i = 0; i < count; i++) {
+            found[i] = filestats(files[i], &stats[i]);
+        }
+    }
+    int listdir(const char* path, PathList** files, PathList** dirs) {
+        DIR *dir = opendir(path);
+        if (!dir) return 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char full_path[PATH_MAX];
+            snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
+            }
+            pathlist_add(isdir ? dirs : files, full_path);
+        }
+        closedir(dir);
+        return 1;
+    }
+
+    int replacefile(const char* src, const char* dst) {
+        return rename(src, dst) == 0;
+    }
+    int touchfile(const char* file) {
+        return utimes(file, NULL) == 0;
+    }
+    const char* mapfile(const char* file, size_t* size, int* mapped) {
+        int fd = open(file, O_RDONLY);
+        if (fd < 0) return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return NULL;
+        }
+        *size = (size_t)st.st_size;
+        // a resident watcher or daemon must survive an editor truncating a file mid-build, which
+        // is a SIGBUS on a mapping, so it always reads
+        *mapped = *size >= MAP_THRESHOLD && !(s_flags & (WATCH | DAEMON));
+        char* data = NULL;
+        if (*mapped) {
+            void* mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapping == MAP_FAILED ? NULL : (char*)mapping;
+        } else {
+            data = malloc(*size + 1);
+            size_t total = 0;
+            while (total < *size) {
+                ssize_t bytes = read(fd, data + total, *size - total);
+                if (bytes < 0 && errno == EINTR) continue;
+                if (bytes <= 0) break;
+                total += (size_t)bytes;
+            }
+            *size = total;
+        }
+        close(fd);
+        return data;
+    }
+    void unmapfile(const char* data, size_t size, int mapped) {
+        if (mapped) {
+            munmap((void*)data, size);
+        } else {
+            free((void*)data);
+        }
+    }
+    void copyfile(const char* src, const char* dst) {
+        int in = open(src, O_RDONLY);
+        if (in < 0) {
+            crash("Failed to open source file \"%s\"", src);
+        }
+        struct stat st;
+        if (fstat(in, &st) != 0) {
+            close(in);
+            crash("Failed to stat source file \"%s\"", src);
+        }
+        int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            close(in);
+            crash("Failed to open destination file \"%s\"", dst);
+        }
+        off_t copied = 0;
+        if (ioctl(out, FICLONE, in) == 0) copied = st.st_size;
+        while (copied < st.st_size) {
+            ssize_t bytes = syscall(SYS_copy_file_range, in, NULL, out, NULL, (size_t)(st.st_size - copied), 0);
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes <= 0) break;
+            copied += bytes;
+        }
+        if (copied >= st.st_size) {
+            close(in);
+            if (close(out) != 0) {
+                crash("Critical write error during copying");
+            }
+            return;
+        }
+        char buffer[COPY_BUFFER_SIZE];
+        ssize_t bytes;
+        while ((bytes = read(in, buffer, sizeof(buffer))) != 0) {
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                close(in);
+                close(out);
+                crash("Critical read error during copying");
+            }
+            ssize_t written = 0;
+            while (written < bytes) {
+                ssize_t result = write(out, buffer + written, (size_t)(bytes - written));
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) {
+                    close(in);
+                    close(out);
+                    crash("Critical write error during copying");
+                }
+                written += result;
+            }
+        }
+        close(in);
+        if (close(out) != 0) {
+            crash("Critical write error during copying");
+        }
+    }
+
     void walkdir(const char* path, FileHandler func) {
         DIR *dir = opendir(path);
         if (!dir) {
@@ -386,11 +1247,15 @@ int s_max_argsc = 0;
             if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
             char full_path[PATH_MAX];
             snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-            struct stat statbuf;
-            if (stat(full_path, &statbuf) != 0) {
-                crash("Stat call failed");
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
             }
-            if (S_ISDIR(statbuf.st_mode)) {
+            if (isdir) {
                 func(full_path);
                 walkdir(full_path, func);
             }
@@ -408,11 +1273,15 @@ int s_max_argsc = 0;
             if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
             char full_path[PATH_MAX];
             snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-            struct stat statbuf;
-            if (stat(full_path, &statbuf) != 0) {
-                crash("Stat call failed");
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
             }
-            if (!S_ISDIR(statbuf.st_mode)) {
+            if (!isdir) {
                 func(full_path);
             } else {
                 walkfiles(full_path, func);
@@ -426,8 +1295,14 @@ int s_max_argsc = 0;
         gettimeofday(&tv, NULL);
         return (uint64_t)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
     }
+
+    uint64_t microtime() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
 #elif __WIN32
-    void run_build() {
+    void launch_build() {
         affirmdir("build/env");
         char command_line[PATHLEN * 2] = { 0 };
         int offset = 0;
@@ -441,7 +1316,74 @@ int s_max_argsc = 0;
             crash("CreateProcess failed");
         }
         CloseHandle(pi.hThread);
-        CloseHandle(pi.hProcess);
+        s_run_process = pi.hProcess;
+    }
+
+    void run_build() {
+        launch_build();
+        CloseHandle(s_run_process);
+        s_run_process = NULL;
+    }
+
+    void stop_build() {
+        if (s_run_process == NULL) return;
+        TerminateProcess(s_run_process, 1);
+        WaitForSingleObject(s_run_process, INFINITE);
+        CloseHandle(s_run_process);
+        s_run_process = NULL;
+    }
+
+    void restart_self(char* argv[]) {
+        fflush(stdout);
+        _execvp(argv[0], (const char* const*)argv);
+        crash("Unable to restart \"%s\"", argv[0]);
+    }
+
+    int daemon_connect() {
+        return -1;
+    }
+
+    int daemon_forward(int argc, char* argv[]) {
+        return DAEMON_REFUSED;
+    }
+
+    int daemon_listen() {
+        crash("The build daemon is not supported on Windows");
+    }
+
+    void daemon_serve(int argc, char* argv[]) {
+        crash("The build daemon is not supported on Windows");
+    }
+
+    void build_lock() {
+        if (s_build_locked) return;
+        // local builds and watchers share build/, so only one of them may build at a time,
+        // the lock lives outside build/cache so cleaning or importing the cache cannot delete it
+        affirmdir("build");
+        s_build_lock = CreateFileA(LOCK_PATH, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (s_build_lock == INVALID_HANDLE_VALUE) {
+            crash("Unable to open the build lock \"%s\"", LOCK_PATH);
+        }
+        OVERLAPPED region = { 0 };
+        if (!LockFileEx(s_build_lock, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &region)) {
+            print("Waiting for another build of this project to finish...");
+            if (!LockFileEx(s_build_lock, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &region)) {
+                crash("Unable to take the build lock \"%s\"", LOCK_PATH);
+            }
+        }
+        s_build_locked = 1;
+    }
+
+    void build_unlock() {
+        if (!s_build_locked) return;
+        CloseHandle(s_build_lock);
+        s_build_locked = 0;
+    }
+
+    void watch_wait(int argc, char* argv[]) {
+        while (state_current(argc, argv, NULL)) {
+            TINY_SLEEP(WATCH_POLL_MS);
+        }
     }
 
     int make_symlink(const char* src, const char* dest) {
@@ -506,12 +1448,77 @@ int s_max_argsc = 0;
         return rc;
     }
 
+    int spawnprocess(char* const argv[], const char* output, const char* errors, ProcessResult* result) {
+        size_t len = 1;
+        for (int i = 0; argv[i] != NULL; i++) {
+            len += strlen(argv[i]) * 2 + 3;
+        }
+        char* command_line = calloc(len, sizeof(char));
+        size_t o = 0;
+        for (int i = 0; argv[i] != NULL; i++) {
+            if (i > 0) command_line[o++] = ' ';
+            int quoted = argv[i][0] == '\0' || strpbrk(argv[i], " \t\"") != NULL;
+            if (quoted) command_line[o++] = '"';
+            size_t backslashes = 0;
+            for (const char* c = argv[i]; *c != '\0'; c++) {
+                if (*c == '\\') {
+                    backslashes++;
+                } else if (*c == '"') {
+                    for (size_t b = 0; b < backslashes + 1; b++) command_line[o++] = '\\';
+                    backslashes = 0;
+                } else {
+                    backslashes = 0;
+                }
+                command_line[o++] = *c;
+            }
+            if (quoted) {
+                for (size_t b = 0; b < backslashes; b++) command_line[o++] = '\\';
+                command_line[o++] = '"';
+            }
+        }
+        command_line[o] = '\0';
+        SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+        HANDLE out = INVALID_HANDLE_VALUE;
+        HANDLE err = INVALID_HANDLE_VALUE;
+        if (output) out = CreateFileA(output, GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (errors) err = CreateFileA(errors, GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        STARTUPINFOA si = { 0 };
+        PROCESS_INFORMATION pi = { 0 };
+        si.cb = sizeof(si);
+        if (output || errors) {
+            si.dwFlags = STARTF_USESTDHANDLES;
+            si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            si.hStdOutput = out != INVALID_HANDLE_VALUE ? out : GetStdHandle(STD_OUTPUT_HANDLE);
+            si.hStdError = err != INVALID_HANDLE_VALUE ? err : GetStdHandle(STD_ERROR_HANDLE);
+        }
+        int spawned = CreateProcessA(NULL, command_line, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+        free(command_line);
+        if (out != INVALID_HANDLE_VALUE) CloseHandle(out);
+        if (err != INVALID_HANDLE_VALUE) CloseHandle(err);
+        if (!spawned) {
+            return 0;
+        }
+        WaitForSingleObject(pi.hProcess, INFINITE);
+        DWORD code = 1;
+        GetExitCodeProcess(pi.hProcess, &code);
+        CloseHandle(pi.hThread);
+        CloseHandle(pi.hProcess);
+        result->exited = 1;
+        result->code = (int)code;
+        result->signal = 0;
+        return 1;
+    }
+
     int threadcount() {
         SYSTEM_INFO sysinfo;
         GetSystemInfo(&sysinfo);
         return (int)sysinfo.dwNumberOfProcessors;
     }
 
+    double loadaverage() {
+        return 0;
+    }
+
     int dexists(const char* dir) {
         struct _stat statbuf;
         if (_stat(dir, &statbuf) != 0) {
@@ -528,6 +1535,98 @@ int s_max_argsc = 0;
         return (statbuf.st_mode & _S_IFDIR) == 0;
     }
 
+    int filestats(const char* file, FileStats* stats) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(file, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            return 0;
+        }
+        stats->size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        stats->mtime = (((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+        stats->inode = 0;
+        return 1;
+    }
+    int dirmtime(const char* dir, uint64_t* mtime) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(dir, GetFileExInfoStandard, &data) || !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            return 0;
+        }
+        *mtime = (((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+        return 1;
+    }
+    void filestats_batch(const char** files, FileStats* stats, int* found, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            found[i] = filestats(files[i], &stats[i]);
+        }
+    }
+    int listdir(const char* path, PathList** files, PathList** dirs) {
+        char search_path[MAX_PATH];
+        snprintf(search_path, MAX_PATH, "%s/*", path);
+        WIN32_FIND_DATAA find_data;
+        HANDLE hFind = FindFirstFileA(search_path, &find_data);
+        if (hFind == INVALID_HANDLE_VALUE) return 0;
+        do {
+            const char *name = find_data.cFileName;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+            char full_path[MAX_PATH];
+            snprintf(full_path, MAX_PATH, "%s/%s", path, name);
+            pathlist_add((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? dirs : files, full_path);
+        } while (FindNextFileA(hFind, &find_data) != 0);
+        FindClose(hFind);
+        return 1;
+    }
+
+    int replacefile(const char* src, const char* dst) {
+        return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+    }
+    int touchfile(const char* file) {
+        HANDLE handle = CreateFileA(file, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE) return 0;
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        int result = SetFileTime(handle, NULL, &now, &now) != 0;
+        CloseHandle(handle);
+        return result;
+    }
+    const char* mapfile(const char* file, size_t* size, int* mapped) {
+        HANDLE handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE) return NULL;
+        LARGE_INTEGER length;
+        if (!GetFileSizeEx(handle, &length)) {
+            CloseHandle(handle);
+            return NULL;
+        }
+        *size = (size_t)length.QuadPart;
+        // a mapped view blocks editors from truncating the file, so resident modes always read
+        *mapped = *size >= MAP_THRESHOLD && !(s_flags & (WATCH | DAEMON));
+        char* data = NULL;
+        if (*mapped) {
+            HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL) {
+                data = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        } else {
+            data = malloc(*size + 1);
+            DWORD bytes = 0;
+            if (!ReadFile(handle, data, (DWORD)*size, &bytes, NULL)) bytes = 0;
+            *size = bytes;
+        }
+        CloseHandle(handle);
+        return data;
+    }
+    void unmapfile(const char* data, size_t size, int mapped) {
+        if (mapped) {
+            UnmapViewOfFile(data);
+        } else {
+            free((void*)data);
+        }
+    }
+    void copyfile(const char* src, const char* dst) {
+        if (!CopyFileA(src, dst, FALSE)) {
+            crash("Failed to copy \"%s\" to \"%s\"", src, dst);
+        }
+    }
+
     void walkdir(const char* path, FileHandler func) {
         char search_path[MAX_PATH];
         snprintf(search_path, MAX_PATH, "%s/*", path);
@@ -574,11 +1673,28 @@ int s_max_argsc = 0;
     uint64_t mtime() {
         return (uint64_t)GetTickCount64();
     }
+
+    uint64_t microtime() {
+        LARGE_INTEGER frequency, counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 + (counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+    }
 #elif __APPLE__
     void run_build() {
-        affirmdir("build/env");
-        pid_t pid = fork();
-        if (pid < 0) {
+        launch_build();
+        int status;
+        if (waitpid(s_run_process, &status, 0) < 0) {
+            crash("Unable to wait on executable cleanup");
+        }
+        s_run_process = 0;
+    }
+
+    void launch_build() {
+        affirmdir("build/env");
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
             crash("Fork error");
         }
         if (pid == 0) {
@@ -589,9 +1705,219 @@ int s_max_argsc = 0;
             execv("../bin.exe", s_copy_argsv);
             crash("Unable to run executable");
         }
-        int status;
-        if (waitpid(pid, &status, 0) < 0) {
-            crash("Unable to wait on executable cleanup");
+        s_run_process = pid;
+    }
+
+    void stop_build() {
+        if (s_run_process <= 0) return;
+        kill(s_run_process, SIGTERM);
+        for (int i = 0; i < 10 && waitpid(s_run_process, NULL, WNOHANG) == 0; i++) {
+            if (i == 9) {
+                kill(s_run_process, SIGKILL);
+                waitpid(s_run_process, NULL, 0);
+            } else {
+                TINY_SLEEP(100);
+            }
+        }
+        s_run_process = 0;
+    }
+
+    void restart_self(char* argv[]) {
+        fflush(stdout);
+        execvp(argv[0], argv);
+        crash("Unable to restart \"%s\"", argv[0]);
+    }
+
+    int daemon_connect() {
+        struct sockaddr_un address = { 0 };
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, DAEMON_SOCKET, sizeof(address.sun_path) - 1);
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) return -1;
+        if (connect(server, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            close(server);
+            return -1;
+        }
+        return server;
+    }
+
+    int daemon_forward(int argc, char* argv[]) {
+        int server = daemon_connect();
+        if (server < 0) return DAEMON_REFUSED;
+        char header[64] = { 0 };
+        int length = snprintf(header, sizeof(header), "TINY REQUEST %d %d\n", DAEMON_VERSION, argc);
+        int sent = write(server, header, length) == length;
+        for (int i = 0; i < argc && sent; i++) {
+            sent = write(server, argv[i], strlen(argv[i]) + 1) == (ssize_t)(strlen(argv[i]) + 1);
+        }
+        if (!sent) {
+            close(server);
+            return DAEMON_REFUSED;
+        }
+        shutdown(server, SHUT_WR);
+        // output streams back verbatim until a NUL, followed by the build status and whether to run
+        char buffer[4096];
+        char trailer[2] = { 0, 0 };
+        int trailing = -1;
+        ssize_t count = 0;
+        while (trailing < 2 && (count = read(server, buffer, sizeof(buffer))) > 0) {
+            char* cursor = buffer;
+            if (trailing < 0) {
+                char* end = memchr(buffer, '\0', count);
+                fwrite(buffer, 1, end ? end - buffer : count, stdout);
+                if (end == NULL) continue;
+                trailing = 0;
+                cursor = end + 1;
+            }
+            while (cursor < buffer + count && trailing < 2) trailer[trailing++] = *cursor++;
+        }
+        close(server);
+        fflush(stdout);
+        if (trailer[0] == 'R') return DAEMON_REFUSED;
+        // the restarted daemon keeps the socket, so the retry queues behind its first build
+        if (trailer[0] == 'S') return daemon_forward(argc, argv);
+        if (trailing < 2 || (trailer[0] != '0' && trailer[0] != '1')) {
+            print("Lost connection to the build daemon");
+            return 1;
+        }
+        if (trailer[1] == 'r' && !(s_flags & RUN)) {
+            char run[] = "-r";
+            parseflag(run, 0);
+        }
+        return trailer[0] - '0';
+    }
+
+    int daemon_listen() {
+        // a restarting daemon hands its socket down so queued clients are not dropped
+        const char* inherited = getenv("TINY_DAEMON_FD");
+        if (inherited != NULL) {
+            int server = atoi(inherited);
+            unsetenv("TINY_DAEMON_FD");
+            fcntl(server, F_SETFD, FD_CLOEXEC);
+            return server;
+        }
+        int server = daemon_connect();
+        if (server >= 0) {
+            close(server);
+            crash("A build daemon is already serving this project");
+        }
+        affirmdir("build");
+        struct sockaddr_un address = { 0 };
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, DAEMON_SOCKET, sizeof(address.sun_path) - 1);
+        remove(DAEMON_SOCKET);
+        server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0 || fcntl(server, F_SETFD, FD_CLOEXEC) != 0 ||
+            bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0) {
+            crash("Unable to open the build daemon socket \"%s\"", DAEMON_SOCKET);
+        }
+        return server;
+    }
+
+    void daemon_serve(int argc, char* argv[]) {
+        // clients that hang up mid-build must not take the daemon down with them
+        signal(SIGPIPE, SIG_IGN);
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        print("Serving builds on \"%s\"...", DAEMON_SOCKET);
+        size_t capacity = PATHLEN;
+        char* request = malloc(capacity);
+        while (1) {
+            int client = accept(s_daemon_fd, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                crash("Unable to accept build daemon clients");
+            }
+            fcntl(client, F_SETFD, FD_CLOEXEC);
+            // a client that never finishes its request must not hold up everyone queued behind it
+            struct timeval timeout = { DAEMON_TIMEOUT_MS / 1000, (DAEMON_TIMEOUT_MS % 1000) * 1000 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            size_t size = 0;
+            ssize_t count = 0;
+            while ((count = read(client, request + size, capacity - size - 1)) > 0) {
+                size += count;
+                if (size + 1 == capacity) {
+                    capacity *= 2;
+                    request = realloc(request, capacity);
+                }
+            }
+            if (count < 0) {
+                warn("Dropped a build daemon client that did not finish its request");
+                close(client);
+                continue;
+            }
+            request[size] = '\0';
+            int version = 0;
+            int request_argc = 0;
+            int offset = 0;
+            char* request_argv[PATHLEN / 4];
+            if (sscanf(request, "TINY REQUEST %d %d\n%n", &version, &request_argc, &offset) != 2 || offset == 0 ||
+                version != DAEMON_VERSION || request_argc <= 0 || request_argc > PATHLEN / 4) {
+                close(client);
+                continue;
+            }
+            char* cursor = request + offset;
+            for (int i = 0; i < request_argc; i++) {
+                request_argv[i] = cursor < request + size ? cursor : "";
+                cursor += strlen(cursor) + 1;
+            }
+            // compiler diagnostics and the linker write to stderr, so both streams go to the client
+            fflush(stdout);
+            fflush(stderr);
+            int console = dup(STDOUT_FILENO);
+            int errors = dup(STDERR_FILENO);
+            dup2(client, STDOUT_FILENO);
+            dup2(client, STDERR_FILENO);
+            int status = daemon_request(argc, argv, request_argc, request_argv);
+            fflush(stdout);
+            fflush(stderr);
+            dup2(console, STDOUT_FILENO);
+            dup2(errors, STDERR_FILENO);
+            close(console);
+            close(errors);
+            char trailer[3] = { '\0', status == DAEMON_REFUSED ? 'R' : status == DAEMON_RESTART ? 'S' : '0' + status, s_flags & RUN ? 'r' : '-' };
+            if (write(client, trailer, sizeof(trailer)) != sizeof(trailer)) {
+                warn("Build daemon client hung up before the build finished");
+            }
+            close(client);
+            if (status == DAEMON_RESTART) {
+                print("Restarting the build daemon...");
+                char inherited[32] = { 0 };
+                snprintf(inherited, sizeof(inherited), "%d", s_daemon_fd);
+                setenv("TINY_DAEMON_FD", inherited, 1);
+                fcntl(s_daemon_fd, F_SETFD, 0);
+                restart_self(argv);
+            }
+            print("Served a build request - %s", status == DAEMON_REFUSED ? "refused" : status == 0 ? "\033[32msucceeded\033[0m" : "\033[31mfailed\033[0m");
+        }
+    }
+
+    void build_lock() {
+        if (s_build_locked) return;
+        // local builds, watchers and the daemon all share build/, so only one of them may build at a time,
+        // the lock lives outside build/cache so cleaning or importing the cache cannot delete it
+        affirmdir("build");
+        s_build_lock = open(LOCK_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (s_build_lock < 0) {
+            crash("Unable to open the build lock \"%s\"", LOCK_PATH);
+        }
+        if (flock(s_build_lock, LOCK_EX | LOCK_NB) != 0) {
+            print("Waiting for another build of this project to finish...");
+            while (flock(s_build_lock, LOCK_EX) != 0) {
+                if (errno != EINTR) crash("Unable to take the build lock \"%s\"", LOCK_PATH);
+            }
+        }
+        s_build_locked = 1;
+    }
+
+    void build_unlock() {
+        if (!s_build_locked) return;
+        close(s_build_lock);
+        s_build_locked = 0;
+    }
+
+    void watch_wait(int argc, char* argv[]) {
+        while (state_current(argc, argv, NULL)) {
+            TINY_SLEEP(WATCH_POLL_MS);
         }
     }
 
@@ -648,10 +1974,38 @@ int s_max_argsc = 0;
         return -1;
     }
 
+    int spawnprocess(char* const argv[], const char* output, const char* errors, ProcessResult* result) {
+        extern char** environ;
+        pid_t pid;
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (output) posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (errors) posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, errors, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int spawned = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ) == 0;
+        posix_spawn_file_actions_destroy(&actions);
+        if (!spawned) {
+            return 0;
+        }
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) return 0;
+        }
+        result->exited = WIFEXITED(status);
+        result->code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        result->signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+        return 1;
+    }
+
     int threadcount() {
         return (int)sysconf(_SC_NPROCESSORS_ONLN);
     }
 
+    double loadaverage() {
+        double load[1] = { 0 };
+        if (getloadavg(load, 1) != 1) return 0;
+        return load[0];
+    }
+
     int dexists(const char* dir) {
         struct stat statbuf;
         if (stat(dir, &statbuf) != 0) {
@@ -668,6 +2022,133 @@ int s_max_argsc = 0;
         return !S_ISDIR(statbuf.st_mode);
     }
 
+    int filestats(const char* file, FileStats* stats) {
+        struct stat statbuf;
+        if (stat(file, &statbuf) != 0 || S_ISDIR(statbuf.st_mode)) {
+            return 0;
+        }
+        stats->size = (uint64_t)statbuf.st_size;
+        stats->mtime = (uint64_t)statbuf.st_mtimespec.tv_sec * 1000000000 + (uint64_t)statbuf.st_mtimespec.tv_nsec;
+        stats->inode = (uint64_t)statbuf.st_ino;
+        return 1;
+    }
+    int dirmtime(const char* dir, uint64_t* mtime) {
+        struct stat statbuf;
+        if (stat(dir, &statbuf) != 0 || !S_ISDIR(statbuf.st_mode)) {
+            return 0;
+        }
+        *mtime = (uint64_t)statbuf.st_mtimespec.tv_sec * 1000000000 + (uint64_t)statbuf.st_mtimespec.tv_nsec;
+        return 1;
+    }
+    void filestats_batch(const char** files, FileStats* stats, int* found, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            found[i] = filestats(files[i], &stats[i]);
+        }
+    }
+    int listdir(const char* path, PathList** files, PathList** dirs) {
+        DIR *dir = opendir(path);
+        if (!dir) return 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char full_path[PATH_MAX];
+            snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
+            }
+            pathlist_add(isdir ? dirs : files, full_path);
+        }
+        closedir(dir);
+        return 1;
+    }
+
+    int replacefile(const char* src, const char* dst) {
+        return rename(src, dst) == 0;
+    }
+    int touchfile(const char* file) {
+        return utimes(file, NULL) == 0;
+    }
+    const char* mapfile(const char* file, size_t* size, int* mapped) {
+        int fd = open(file, O_RDONLY);
+        if (fd < 0) return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return NULL;
+        }
+        *size = (size_t)st.st_size;
+        // a resident watcher or daemon must survive an editor truncating a file mid-build, which
+        // is a SIGBUS on a mapping, so it always reads
+        *mapped = *size >= MAP_THRESHOLD && !(s_flags & (WATCH | DAEMON));
+        char* data = NULL;
+        if (*mapped) {
+            void* mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapping == MAP_FAILED ? NULL : (char*)mapping;
+        } else {
+            data = malloc(*size + 1);
+            size_t total = 0;
+            while (total < *size) {
+                ssize_t bytes = read(fd, data + total, *size - total);
+                if (bytes < 0 && errno == EINTR) continue;
+                if (bytes <= 0) break;
+                total += (size_t)bytes;
+            }
+            *size = total;
+        }
+        close(fd);
+        return data;
+    }
+    void unmapfile(const char* data, size_t size, int mapped) {
+        if (mapped) {
+            munmap((void*)data, size);
+        } else {
+            free((void*)data);
+        }
+    }
+    void copyfile(const char* src, const char* dst) {
+        remove(dst);
+        if (clonefile(src, dst, 0) == 0) return;
+        int in = open(src, O_RDONLY);
+        if (in < 0) {
+            crash("Failed to open source file \"%s\"", src);
+        }
+        int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            close(in);
+            crash("Failed to open destination file \"%s\"", dst);
+        }
+        char buffer[COPY_BUFFER_SIZE];
+        ssize_t bytes;
+        while ((bytes = read(in, buffer, sizeof(buffer))) != 0) {
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                close(in);
+                close(out);
+                crash("Critical read error during copying");
+            }
+            ssize_t written = 0;
+            while (written < bytes) {
+                ssize_t result = write(out, buffer + written, (size_t)(bytes - written));
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) {
+                    close(in);
+                    close(out);
+                    crash("Critical write error during copying");
+                }
+                written += result;
+            }
+        }
+        close(in);
+        if (close(out) != 0) {
+            crash("Critical write error during copying");
+        }
+    }
+
     void walkdir(const char* path, FileHandler func) {
         DIR *dir = opendir(path);
         if (!dir) {
@@ -678,11 +2159,15 @@ int s_max_argsc = 0;
             if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
             char full_path[PATH_MAX];
             snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-            struct stat statbuf;
-            if (stat(full_path, &statbuf) != 0) {
-                crash("Stat call failed");
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
             }
-            if (S_ISDIR(statbuf.st_mode)) {
+            if (isdir) {
                 func(full_path);
                 walkdir(full_path, func);
             }
@@ -700,11 +2185,15 @@ int s_max_argsc = 0;
             if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
             char full_path[PATH_MAX];
             snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-            struct stat statbuf;
-            if (stat(full_path, &statbuf) != 0) {
-                crash("Stat call failed");
+            int isdir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat statbuf;
+                if (stat(full_path, &statbuf) != 0) {
+                    crash("Stat call failed");
+                }
+                isdir = S_ISDIR(statbuf.st_mode);
             }
-            if (!S_ISDIR(statbuf.st_mode)) {
+            if (!isdir) {
                 func(full_path);
             } else {
                 walkfiles(full_path, func);
@@ -718,6 +2207,12 @@ int s_max_argsc = 0;
         gettimeofday(&tv, NULL);
         return (uint64_t)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
     }
+
+    uint64_t microtime() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
 #else
     #error "Unsupported operating system detected!"
 #endif
@@ -734,6 +2229,7 @@ void integrate_modules() {
     if (curr != NULL) {
         print("Integrating modules...");
         uint64_t timer = mtime();
+        uint64_t traced = microtime();
         while (!curr->module.integrated) {
             char fpbuffer[PATHLEN] = { 0 };
             char mbuffer[PATHLEN] = { 0 };
@@ -761,6 +2257,7 @@ void integrate_modules() {
         float seconds;
         dissect_time_elapsed(timer, &hours, &minutes, &seconds);
         print("\033[32mFinished\033[0m integrating modules in %d:%d:%.3f", hours, minutes, seconds);
+        trace_phase("Integrating modules", traced);
     }
 }
 
@@ -893,50 +2390,285 @@ void modulelist_add(ModuleList** list, Module module) {
 }
 
 void modulelist_delete(ModuleList* list) {
-    if (list == NULL) return;
-    ModuleList* n = (ModuleList*)list->next;
-    free(list);
-    modulelist_delete(n);
+    while (list != NULL) {
+        ModuleList* n = (ModuleList*)list->next;
+        free(list);
+        list = n;
+    }
+}
+
+void* arena_alloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (s_arena == NULL || s_arena->used + size > s_arena->capacity) {
+        ArenaBlock* block = calloc(1, sizeof(ArenaBlock));
+        block->capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block->data = malloc(block->capacity);
+        if (!block->data) {
+            crash("Unable to allocate %zu bytes of path storage", block->capacity);
+        }
+        block->next = s_arena;
+        s_arena = block;
+    }
+    void* memory = s_arena->data + s_arena->used;
+    s_arena->used += size;
+    return memory;
+}
+
+size_t internlen(const char* str) {
+    uint32_t length;
+    memcpy(&length, str - sizeof(uint32_t), sizeof(uint32_t));
+    return length;
+}
+
+const char* intern(const char* str) {
+    size_t length = strlen(str);
+    uint64_t hash = fnv1a(str, length, 0xcbf29ce484222325ULL);
+    TINY_LOCK_MUTEX(s_arena_mutex);
+    if ((s_interned_count + 1) * 4 >= s_interned_capacity * 3) {
+        size_t capacity = s_interned_capacity ? s_interned_capacity * 2 : 1024;
+        const char** grown = calloc(capacity, sizeof(char*));
+        for (size_t i = 0; i < s_interned_capacity; i++) {
+            if (!s_interned[i]) continue;
+            size_t j = fnv1a(s_interned[i], internlen(s_interned[i]), 0xcbf29ce484222325ULL) & (capacity - 1);
+            while (grown[j]) j = (j + 1) & (capacity - 1);
+            grown[j] = s_interned[i];
+        }
+        free(s_interned);
+        s_interned = grown;
+        s_interned_capacity = capacity;
+    }
+    size_t i = hash & (s_interned_capacity - 1);
+    while (s_interned[i]) {
+        if (internlen(s_interned[i]) == length && memcmp(s_interned[i], str, length) == 0) {
+            TINY_RELEASE_MUTEX(s_arena_mutex);
+            return s_interned[i];
+        }
+        i = (i + 1) & (s_interned_capacity - 1);
+    }
+    char* stored = (char*)arena_alloc(sizeof(uint32_t) + length + 1) + sizeof(uint32_t);
+    uint32_t prefix = (uint32_t)length;
+    memcpy(stored - sizeof(uint32_t), &prefix, sizeof(uint32_t));
+    memcpy(stored, str, length + 1);
+    s_interned[i] = stored;
+    s_interned_count++;
+    TINY_RELEASE_MUTEX(s_arena_mutex);
+    return stored;
+}
+
+FileView* fileview(const char* path) {
+    TINY_LOCK_MUTEX(s_view_mutex);
+    FileView* view = (FileView*)hashmap_get(&s_views, path);
+    if (view == NULL) {
+        size_t size = 0;
+        int mapped = 0;
+        const char* data = mapfile(path, &size, &mapped);
+        if (data != NULL) {
+            view = calloc(1, sizeof(FileView));
+            view->data = data;
+            view->size = size;
+            view->mapped = mapped;
+            hashmap_put(&s_views, path, view);
+        }
+    }
+    TINY_RELEASE_MUTEX(s_view_mutex);
+    return view;
+}
+
+int fileview_line(FileView* view, size_t index, char* line, size_t size) {
+    if (view->lines == NULL) {
+        size_t count = 0;
+        for (size_t i = 0; i < view->size; i++) {
+            if (view->data[i] == '\n') count++;
+        }
+        view->lines = malloc((count + 2) * sizeof(size_t));
+        view->lines[0] = 0;
+        view->line_count = 0;
+        for (size_t i = 0; i < view->size; i++) {
+            if (view->data[i] == '\n') view->lines[++view->line_count] = i + 1;
+        }
+        if (view->lines[view->line_count] < view->size) view->lines[++view->line_count] = view->size;
+    }
+    if (index >= view->line_count) return 0;
+    size_t len = view->lines[index + 1] - view->lines[index];
+    if (len > size - 1) len = size - 1;
+    memcpy(line, view->data + view->lines[index], len);
+    line[len] = '\0';
+    return 1;
+}
+
+uint64_t hashview(const char* path) {
+    FileView* view = fileview(path);
+    if (!view) {
+        crash("Unable to open file \"%s\"", path);
+    }
+    return fnv1a(view->data, view->size, 0xcbf29ce484222325ULL);
+}
+
+void fileviews_close() {
+    for (size_t i = 0; i < s_views.capacity; i++) {
+        FileView* view = (FileView*)s_views.entries[i].value;
+        if (!s_views.entries[i].key || !view) continue;
+        unmapfile(view->data, view->size, view->mapped);
+        free(view->lines);
+    }
+    hashmap_clear(&s_views, 1);
 }
 
 void pathlist_add(PathList** list, const char* path) {
-    PathList* new = calloc(1, sizeof(PathList));
-    new->next = NULL;
-    strncpy(new->str, path, PATHLEN);
-    if (*list == NULL) {
-        *list = new;
-        return;
+    const char* str = intern(path);
+    TINY_LOCK_MUTEX(s_arena_mutex);
+    PathList* new = s_free_nodes;
+    if (new != NULL) {
+        s_free_nodes = (PathList*)new->next;
+    } else {
+        new = (PathList*)arena_alloc(sizeof(PathList));
     }
-    PathList* current = *list;
-    new->next = current;
+    TINY_RELEASE_MUTEX(s_arena_mutex);
+    new->str = str;
+    new->next = *list;
     *list = new;
 }
 
 void pathlist_delete(PathList* list) {
     if (list == NULL) return;
-    PathList* n = (PathList*)list->next;
-    free(list);
-    pathlist_delete(n);
+    PathList* tail = list;
+    while (tail->next != NULL) tail = (PathList*)tail->next;
+    TINY_LOCK_MUTEX(s_arena_mutex);
+    tail->next = s_free_nodes;
+    s_free_nodes = list;
+    TINY_RELEASE_MUTEX(s_arena_mutex);
 }
 
 size_t pathlist_len(PathList* list) {
-    if (list == NULL) return 0;
-    return 1 + pathlist_len(list->next);
+    size_t len = 0;
+    while (list != NULL) {
+        len++;
+        list = (PathList*)list->next;
+    }
+    return len;
 }
 
-void pathlist_construct(PathList* list, char* output) {
-    size_t outcounter = 0;
+void arglist_add(ArgList* args, const char* arg) {
+    if (args->count + 2 > args->capacity) {
+        args->capacity = args->capacity ? args->capacity * 2 : 32;
+        args->argv = realloc(args->argv, args->capacity * sizeof(char*));
+    }
+    args->argv[args->count++] = strdup(arg);
+    args->argv[args->count] = NULL;
+}
+
+void arglist_extend(ArgList* args, PathList* list, int split) {
     PathList* curr = list;
     while (curr != NULL) {
-        strcpy(output + outcounter, curr->str);
-        outcounter += strlen(curr->str);
-        output[outcounter] = ' ';
-        outcounter++;
-        output[outcounter] = '\0';
+        if (split) {
+            arglist_split(args, curr->str);
+        } else {
+            arglist_add(args, curr->str);
+        }
         curr = (PathList*)curr->next;
     }
 }
 
+void arglist_split(ArgList* args, const char* str) {
+    char buffer[PATHLEN] = { 0 };
+    size_t bi = 0;
+    int pending = 0;
+    char quote = 0;
+    for (size_t i = 0; str[i] != '\0'; i++) {
+        if (quote && str[i] == quote) {
+            quote = 0;
+        } else if (!quote && (str[i] == '"' || str[i] == '\'')) {
+            quote = str[i];
+            pending = 1;
+        } else if (!quote && (str[i] == ' ' || str[i] == '\t')) {
+            if (pending) {
+                buffer[bi] = '\0';
+                arglist_add(args, buffer);
+                bi = 0;
+                pending = 0;
+            }
+        } else if (bi < PATHLEN - 1) {
+            buffer[bi++] = str[i];
+            pending = 1;
+        }
+    }
+    if (quote) {
+        crash("Unterminated quote in argument \"%s\"", str);
+    }
+    if (pending) {
+        buffer[bi] = '\0';
+        arglist_add(args, buffer);
+    }
+}
+
+void arglist_unquote(char* buffer, const char* str, size_t size) {
+    // values used to be pasted into a double quoted shell word, so undo one
+    // level of that quoting to keep existing configurations meaning the same
+    size_t bi = 0;
+    int quoted = 1;
+    for (size_t i = 0; str[i] != '\0' && bi < size - 1; i++) {
+        if (str[i] == '"') {
+            quoted = !quoted;
+        } else if (str[i] == '\\' && str[i + 1] != '\0' && (!quoted || strchr("\"\\$`", str[i + 1]) != NULL)) {
+            buffer[bi++] = str[++i];
+        } else {
+            buffer[bi++] = str[i];
+        }
+    }
+    buffer[bi] = '\0';
+}
+
+void arglist_delete(ArgList* args) {
+    for (size_t i = args->borrowed; i < args->count; i++) {
+        free(args->argv[i]);
+    }
+    free(args->argv);
+    free(args);
+}
+
+ArgList* arglist_template(ArgList* template) {
+    ArgList* args = calloc(1, sizeof(ArgList));
+    args->capacity = template->count + 16;
+    args->argv = malloc(args->capacity * sizeof(char*));
+    memcpy(args->argv, template->argv, template->count * sizeof(char*));
+    args->count = template->count;
+    args->borrowed = template->count;
+    args->argv[args->count] = NULL;
+    return args;
+}
+
+char* arglist_render(ArgList* args) {
+    size_t len = 1;
+    for (size_t i = 0; i < args->count; i++) {
+        len += strlen(args->argv[i]) * 4 + 3;
+    }
+    char* output = calloc(len, sizeof(char));
+    size_t o = 0;
+    for (size_t i = 0; i < args->count; i++) {
+        if (strpbrk(args->argv[i], " \t\"'\\$") != NULL || args->argv[i][0] == '\0') {
+            char* q = generate_quote(args->argv[i]);
+            o += sprintf(output + o, "%s%s", i == 0 ? "" : " ", q);
+            free(q);
+        } else {
+            o += sprintf(output + o, "%s%s", i == 0 ? "" : " ", args->argv[i]);
+        }
+    }
+    return output;
+}
+
+int runprocess(ArgList* args, const char* name, const char* output, const char* errors) {
+    ProcessResult result = { 0 };
+    if (!spawnprocess(args->argv, output, errors, &result)) {
+        print("Unable to launch \"%s\" for %s", args->argv[0], name);
+        return 0;
+    }
+    if (!result.exited && result.signal != 0) {
+        print("\"%s\" was terminated by signal %d while building %s", args->argv[0], result.signal, name);
+        return 0;
+    }
+    return result.exited && result.code == 0;
+}
+
 void clean_header_links() {
     while (s_header_links) {
         pathlist_delete(s_header_links->link->links);
@@ -981,7 +2713,7 @@ void add_header_link(const char* header, const char* link) {
     }
     HeaderLinkList* new = calloc(1, sizeof(HeaderLinkList));
     new->link = calloc(1, sizeof(HeaderLink));
-    strcpy(new->link->header, header);
+    new->link->header = intern(header);
     pathlist_add(&(new->link->links), link);
     new->next = s_header_links;
     s_header_links = new;
@@ -998,7 +2730,7 @@ void add_source_link(const char* header, const char* link) {
     }
     HeaderLinkList* new = calloc(1, sizeof(HeaderLinkList));
     new->link = calloc(1, sizeof(HeaderLink));
-    strcpy(new->link->header, header);
+    new->link->header = intern(header);
     pathlist_add(&(new->link->links), link);
     new->next = s_source_links;
     s_source_links = new;
@@ -1015,7 +2747,7 @@ void add_header_secondary(const char* header, const char* link) {
     }
     HeaderLinkList* new = calloc(1, sizeof(HeaderLinkList));
     new->link = calloc(1, sizeof(HeaderLink));
-    strcpy(new->link->header, header);
+    new->link->header = intern(header);
     pathlist_add(&(new->link->secondaries), link);
     new->next = s_header_links;
     s_header_links = new;
@@ -1087,20 +2819,19 @@ void easyc_audit(const char* file) {
     if (!header && !source) {
         return;
     }
-    FILE* fp = fopen(file, "r");
-    if (!fp) {
+    FileView* view = fileview(file);
+    if (!view) {
         crash("Failed to open file");
     }
     char line[PATHLEN * 2] = { 0 };
     int linecount = 0;
-    while (fgets(line, sizeof(line), fp)) {
+    while (fileview_line(view, linecount, line, sizeof(line))) {
         linecount++;
         if (strstr(line,"malloc(") || strstr(line, "calloc(") || strstr(line, "free(")) {
             print("Detected unmonitored memory operation in \"%s\" on line %d", file, linecount);
             s_vulnerabilities++;
         }
     }
-    fclose(fp);
 }
 
 void syntax_audit(const char* file) {
@@ -1120,15 +2851,15 @@ void syntax_audit(const char* file) {
             break;
         }
     }
-    FILE* fp = fopen(file, "r");
-    if (!fp) {
+    FileView* view = fileview(file);
+    if (!view) {
         crash("Failed to open file");
     }
     char line[PATHLEN * 2] = { 0 };
     int linecount = 0;
     int prev_empty = 0;
     int header_closed = 0;
-    while (fgets(line, sizeof(line), fp)) {
+    while (fileview_line(view, linecount, line, sizeof(line))) {
         linecount++;
         int linelen = strlen(line);
         if (linelen >= PATHLEN) {
@@ -1211,14 +2942,14 @@ void syntax_audit(const char* file) {
                 strcpy(srcfilepath, file);
                 srcfilepath[slen - 1] = 'c';
                 if (fexists(srcfilepath)) {
-                    FILE* sfp = fopen(srcfilepath, "r");
-                    if (!sfp) {
+                    FileView* sview = fileview(srcfilepath);
+                    if (!sview) {
                         crash("Unable to open file");
                     }
                     char srcline[PATHLEN * 2] = { 0 };
                     int srclc = 0;
                     int srcbilc = 0;
-                    while (fgets(srcline, sizeof(srcline), sfp)) {
+                    while (fileview_line(sview, srclc, srcline, sizeof(srcline))) {
                         srclc++;
                         if (strstr(srcline, implbuf)) implfound = 1;
                         if (strstr(srcline, badimplbuf)) {
@@ -1235,7 +2966,6 @@ void syntax_audit(const char* file) {
                             s_vulnerabilities++;
                         }
                     }
-                    fclose(sfp);
                 } else {
                     print("Unable to find a corresponding source for the header \"%s\"", file);
                     s_vulnerabilities++;
@@ -1294,18 +3024,17 @@ void syntax_audit(const char* file) {
                             hfilepath[slen - 1] = 'h';
                             int needs_static = 1;
                             if (fexists(hfilepath)) {
-                                FILE* hfp = fopen(hfilepath, "r");
-                                if (!hfp) {
+                                FileView* hview = fileview(hfilepath);
+                                if (!hview) {
                                     crash("Unable to open file");
                                 }
                                 char hline[PATHLEN * 2] = { 0 };
-                                while (fgets(hline, sizeof(hline), hfp)) {
+                                for (size_t hlc = 0; fileview_line(hview, hlc, hline, sizeof(hline)); hlc++) {
                                     if (strstr(hline, implbuf)) {
                                         needs_static = 0;
                                         break;
                                     }
                                 }
-                                fclose(hfp);
                             }
                             if (needs_static) {
                                 print("The global function detected in \"%s\" on line %d is not translation protected - please make it static.", file, linecount);
@@ -1343,174 +3072,875 @@ void syntax_audit(const char* file) {
         print("Detected empty file \"%s\"", file);
         s_vulnerabilities++;
     }
-    fclose(fp);
 }
 
-void copyfile(const char* src, const char* dst) {
-    FILE* srcFile = fopen(src, "rb");
-    if (!srcFile) {
-        crash("Failed to open source file");
+uint64_t fnv1a(const void* data, size_t len, uint64_t hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
     }
-    FILE *dstFile = fopen(dst, "wb");
-    if (!dstFile) {
-        fclose(srcFile);
-        crash("Failed to open destination file \"%s\"", dst);
-    }
-    char buffer[4096];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), srcFile)) > 0) {
-        if (fwrite(buffer, 1, bytes, dstFile) != bytes) {
-            fclose(srcFile);
-            fclose(dstFile);
-            crash("Critical write error during copying");
-        }
-    }
-    fclose(srcFile);
-    fclose(dstFile);
+    return hash;
 }
 
-int filecmp(const char* path1, const char* path2) {
-    FILE* f1 = fopen(path1, "rb");
-    FILE* f2 = fopen(path2, "rb");
-    if (!f1 || !f2) {
-        fclose(f1);
-        fclose(f2);
-        crash("failure during opening files");
-    }
-    struct stat stat1, stat2;
-    if (stat(path1, &stat1) != 0 || stat(path2, &stat2) != 0) {
-        fclose(f1);
-        fclose(f2);
-        crash("failure during stating files");
-    }
-    if (stat1.st_size != stat2.st_size) {
-        fclose(f1);
-        fclose(f2);
-        return 0;
+uint64_t hashfile(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        crash("Unable to open file \"%s\"", path);
     }
-    char buf1[4096], buf2[4096];
-    size_t bytes1, bytes2;
-    int equal = 1;
-    while ((bytes1 = fread(buf1, 1, 4096, f1)) > 0 &&
-           (bytes2 = fread(buf2, 1, 4096, f2)) > 0) {
-        if (bytes1 != bytes2 || memcmp(buf1, buf2, bytes1) != 0) {
-            equal = 0;
-            break;
-        }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    char buffer[65536];
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        hash = fnv1a(buffer, bytes, hash);
     }
-    fclose(f1);
-    fclose(f2);
-    return equal;
+    fclose(fp);
+    return hash;
 }
 
-void affirmdir(const char* dir) {
-    if (!dexists(dir) && !rmakedir(dir)) {
-        crash("Unable to affirm directory %s", dir);
+uint64_t fnv1a_relocated(const char* data, size_t len, const char* prefix, uint64_t hash) {
+    size_t plen = strlen(prefix);
+    size_t start = 0;
+    for (size_t i = 0; plen > 0 && i + plen <= len; i++) {
+        if (data[i] != prefix[0] || memcmp(data + i, prefix, plen) != 0) continue;
+        char after = i + plen < len ? data[i + plen] : '\0';
+        if (after != '\0' && after != '/' && after != '\\' && after != '"' && after != '=' && after != ' ' && after != '\n') continue;
+        hash = fnv1a(data + start, i - start, hash);
+        hash = fnv1a(".", 1, hash);
+        i += plen - 1;
+        start = i + 1;
     }
+    return fnv1a(data + start, len - start, hash);
 }
 
-void affirm_to_cache(const char* dir) {
-    if (strstr(dir, "build/cache") == &(dir[0]) || strstr(dir, "./build/cache") == &(dir[0])) return;
-    char buffer[PATHLEN] = { 0 };
-    snprintf(buffer, PATHLEN, "build/cache/%s", dir);
-    affirmdir(buffer);
+uint64_t hashfile_relocated(const char* path, const char* prefix, uint64_t hash) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        crash("Unable to open file \"%s\"", path);
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* data = malloc(size > 0 ? size : 1);
+    size_t bytes = fread(data, 1, size > 0 ? size : 0, fp);
+    fclose(fp);
+    hash = fnv1a_relocated(data, bytes, prefix, hash);
+    free(data);
+    return hash;
 }
 
-void add_to_sources(const char* file) {
-    if (strstr(file, "build/cache") == &(file[0]) || strstr(file, "./build/cache") == &(file[0])) return;
-    size_t slen = strlen(file);
-    if (slen > 2 && file[slen - 1] == 'c' && file[slen - 2] == '.')
-        pathlist_add(&s_sources, file);
+void* hashmap_get(HashMap* map, const char* key) {
+    if (map->capacity == 0) return NULL;
+    size_t i = fnv1a(key, strlen(key), 0xcbf29ce484222325ULL) & (map->capacity - 1);
+    while (map->entries[i].key) {
+        if (strcmp(map->entries[i].key, key) == 0) return map->entries[i].value;
+        i = (i + 1) & (map->capacity - 1);
+    }
+    return NULL;
 }
 
-void verify_header(const char* file) {
-    if (strstr(file, "build/cache") == &(file[0]) || strstr(file, "./build/cache") == &(file[0])) return;
-    size_t slen = strlen(file);
-    if (slen > 2 && (file[slen - 1] != 'h' || file[slen - 2] != '.')) return;
-    int basename_ptr = 0;
-    for (int i = slen; i > 0; i--) {
-        if (file[i] == '/' || file[i] == '\\') {
-            basename_ptr = i + 1;
-            break;
+void hashmap_put(HashMap* map, const char* key, void* value) {
+    if ((map->count + 1) * 4 >= map->capacity * 3) {
+        HashMap grown = { 0 };
+        grown.capacity = map->capacity ? map->capacity * 2 : 64;
+        grown.entries = calloc(grown.capacity, sizeof(HashEntry));
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (!map->entries[i].key) continue;
+            size_t j = fnv1a(map->entries[i].key, strlen(map->entries[i].key), 0xcbf29ce484222325ULL) & (grown.capacity - 1);
+            while (grown.entries[j].key) j = (j + 1) & (grown.capacity - 1);
+            grown.entries[j] = map->entries[i];
         }
+        grown.count = map->count;
+        free(map->entries);
+        *map = grown;
     }
-    char destination[PATHLEN] = { 0 };
-    snprintf(destination, PATHLEN, "build/cache/%s", file);
-    if (!fexists(destination)) {
-        pathlist_add(&s_changed_headers, file + basename_ptr);
-        copyfile(file, destination);
-    } else {
-        if (!filecmp(file, destination)) {
-            pathlist_add(&s_changed_headers, file + basename_ptr);
-            copyfile(file, destination);
+    size_t i = fnv1a(key, strlen(key), 0xcbf29ce484222325ULL) & (map->capacity - 1);
+    while (map->entries[i].key) {
+        if (strcmp(map->entries[i].key, key) == 0) {
+            map->entries[i].value = value;
+            return;
         }
+        i = (i + 1) & (map->capacity - 1);
     }
+    map->entries[i].key = intern(key);
+    map->entries[i].value = value;
+    map->count++;
 }
 
-void accumulate_header(const char* file) {
-    if (strstr(file, "build/cache") == &(file[0]) || strstr(file, "./build/cache") == &(file[0])) return;
-    size_t slen = strlen(file);
-    if (slen > 2 && (file[slen - 1] != 'h' || file[slen - 2] != '.')) return;
-    int basename_ptr = 0;
-    for (int i = slen; i > 0; i--) {
-        if (file[i] == '/' || file[i] == '\\') {
-            basename_ptr = i + 1;
-            break;
-        }
+void hashmap_clear(HashMap* map, int free_values) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!map->entries[i].key) continue;
+        if (free_values) free(map->entries[i].value);
     }
-    PathList* curr = s_changed_headers;
-    while (curr != NULL) {
-        if (strcmp(file + basename_ptr, curr->str) == 0) return;
-        curr = (PathList*)curr->next;
-    }
-    FILE* fp = fopen(file, "r");
-    if (!fp) {
-        crash("Unable to open file \"%s\"", file);
+    free(map->entries);
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+ManifestEntry* manifest_entry(const char* path) {
+    ManifestEntry* entry = (ManifestEntry*)hashmap_get(&s_manifest, path);
+    if (!entry) {
+        entry = calloc(1, sizeof(ManifestEntry));
+        hashmap_put(&s_manifest, path, entry);
     }
-    char line[PATHLEN * 2] = { 0 };
-    while (fgets(line, sizeof(line), fp)) {
-        if (strstr(line, "#include") != NULL) {
-            curr = s_changed_headers;
-            while (curr != NULL) {
-                if (strstr(line, curr->str) != NULL) {
-                    pathlist_add(&s_changed_headers, file + basename_ptr);
-                    fclose(fp);
-                    return;
-                }
-                curr = (PathList*)curr->next;
+    return entry;
+}
+
+int manifest_changed(const char* path) {
+    ManifestEntry* entry = manifest_entry(path);
+    if (entry->status == MANIFEST_UNKNOWN) {
+        int found = entry->prefetched ? entry->prefetched > 0 : filestats(path, &(entry->current));
+        if (!found) {
+            entry->status = MANIFEST_CHANGED;
+            return 1;
+        }
+        if (entry->recorded &&
+            entry->current.size == entry->stats.size &&
+            entry->current.mtime == entry->stats.mtime &&
+            entry->current.inode == entry->stats.inode) {
+            entry->current_hash = entry->hash;
+            entry->status = MANIFEST_UNCHANGED;
+        } else {
+            entry->current_hash = hashview(path);
+            if (entry->recorded && entry->current_hash == entry->hash) {
+                entry->stats = entry->current;
+                entry->status = MANIFEST_UNCHANGED;
+            } else {
+                entry->status = MANIFEST_CHANGED;
             }
         }
     }
+    return !entry->recorded || entry->status == MANIFEST_CHANGED;
+}
+
+void manifest_commit(ManifestEntry* entry) {
+    if (entry->status == MANIFEST_UNKNOWN) return;
+    entry->stats = entry->current;
+    entry->hash = entry->current_hash;
+    entry->recorded = 1;
+}
+
+int manifest_stale(const char* path) {
+    int changed = manifest_changed(path);
+    return changed || !manifest_entry(path)->tracked || hashmap_get(&s_dirty, path) != NULL;
+}
+
+void manifest_track(ManifestEntry* entry, const char* depfile) {
+    pathlist_delete(entry->deps);
+    entry->deps = parse_depfile(depfile);
+    entry->tracked = 1;
+    PathList* dep = entry->deps;
+    while (dep != NULL) {
+        if (manifest_changed(dep->str)) pathlist_add(&s_pending_headers, dep->str);
+        dep = (PathList*)dep->next;
+    }
+}
+
+char* normalize_path(const char* path, char* output) {
+    char buffer[PATHLEN] = { 0 };
+    char* parts[PATHLEN / 2];
+    int count = 0;
+    size_t prefix = 0;
+    strncpy(buffer, path, PATHLEN - 1);
+    if (buffer[0] == '/' || buffer[0] == '\\') {
+        prefix = 1;
+    } else if (buffer[0] != '\0' && buffer[1] == ':') {
+        prefix = (buffer[2] == '/' || buffer[2] == '\\') ? 3 : 2;
+    }
+    char* token = buffer + prefix;
+    while (token != NULL && *token != '\0') {
+        char* sep = token;
+        while (*sep != '\0' && *sep != '/' && *sep != '\\') sep++;
+        char* next = *sep == '\0' ? NULL : sep + 1;
+        *sep = '\0';
+        if (strcmp(token, "..") == 0) {
+            if (count > 0 && strcmp(parts[count - 1], "..") != 0) count--;
+            else if (prefix == 0) parts[count++] = token;
+        } else if (*token != '\0' && strcmp(token, ".") != 0) {
+            parts[count++] = token;
+        }
+        token = next;
+    }
+    size_t o = 0;
+    for (size_t i = 0; i < prefix; i++) {
+        output[o++] = path[i] == '\\' ? '/' : path[i];
+    }
+    for (int i = 0; i < count; i++) {
+        o += snprintf(output + o, PATHLEN - o, "%s%s", parts[i], i == count - 1 ? "" : "/");
+    }
+    if (o == 0) output[o++] = '.';
+    output[o] = '\0';
+    return output;
+}
+
+PathList* parse_depfile(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        crash("Unable to open dependency file \"%s\"", path);
+    }
+    PathList* deps = NULL;
+    char token[PATHLEN] = { 0 };
+    char normalized[PATHLEN] = { 0 };
+    size_t ti = 0;
+    int in_target = 1;
+    int skipped_source = 0;
+    int c = fgetc(fp);
+    while (c != EOF) {
+        int next = fgetc(fp);
+        int boundary = 0;
+        if (c == '\\' && (next == '\n' || next == '\r')) {
+            boundary = 1;
+            next = fgetc(fp);
+            if (next == '\n') next = fgetc(fp);
+        } else if (c == '\\' && (next == ' ' || next == '#')) {
+            if (ti < PATHLEN - 1) token[ti++] = (char)next;
+            next = fgetc(fp);
+        } else if (c == '$' && next == '$') {
+            if (ti < PATHLEN - 1) token[ti++] = '$';
+            next = fgetc(fp);
+        } else if (in_target && c == ':' && (next == ' ' || next == '\t' || next == '\n' || next == '\r' || next == EOF)) {
+            in_target = 0;
+            ti = 0;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            boundary = 1;
+        } else if (ti < PATHLEN - 1) {
+            token[ti++] = (char)c;
+        }
+        if ((boundary || next == EOF) && ti > 0 && !in_target) {
+            token[ti] = '\0';
+            if (skipped_source) {
+                pathlist_add(&deps, normalize_path(token, normalized));
+            }
+            skipped_source = 1;
+            ti = 0;
+        } else if (boundary && in_target) {
+            ti = 0;
+        }
+        c = next;
+    }
+    fclose(fp);
+    return deps;
+}
+
+void manifest_load() {
+    FILE* fp = fopen(MANIFEST_PATH, "r");
+    if (!fp) return;
+    char line[PATHLEN * 2] = { 0 };
+    int version = 0;
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "TINY MANIFEST %d", &version) != 1 || version != MANIFEST_VERSION) {
+        warn("Discarding incompatible build manifest - all sources will be rebuilt");
+        fclose(fp);
+        return;
+    }
+    ManifestEntry* last = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        for (int i = strlen(line) - 1; i >= 0; i--) {
+            if (line[i] == '\n' || line[i] == '\r') {
+                line[i] = '\0';
+            } else break;
+        }
+        if (line[0] == 'D' && line[1] == ' ' && last != NULL) {
+            manifest_entry(line + 2);
+            pathlist_add(&(last->deps), line + 2);
+            continue;
+        }
+        ManifestEntry loaded = { 0 };
+        int offset = 0;
+        if ((line[0] != 'F' && line[0] != 'S') ||
+            sscanf(line + 1, " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNx64 " %n",
+                   &loaded.stats.size, &loaded.stats.mtime, &loaded.stats.inode, &loaded.hash, &offset) != 4 ||
+            line[offset + 1] == '\0') {
+            warn("Skipping malformed build manifest line \"%s\"", line);
+            last = NULL;
+            continue;
+        }
+        last = manifest_entry(line + offset + 1);
+        last->stats = loaded.stats;
+        last->hash = loaded.hash;
+        last->recorded = 1;
+        last->tracked = line[0] == 'S';
+    }
+    fclose(fp);
+}
+
+void manifest_save() {
+    FILE* fp = fopen(MANIFEST_PATH ".tmp", "w");
+    if (!fp) {
+        crash("Unable to write build manifest");
+    }
+    fprintf(fp, "TINY MANIFEST %d\n", MANIFEST_VERSION);
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        HashEntry* he = &(s_manifest.entries[i]);
+        if (!he->key || !((ManifestEntry*)he->value)->recorded) continue;
+        ManifestEntry* entry = (ManifestEntry*)he->value;
+        fprintf(fp, "%c %" PRIu64 " %" PRIu64 " %" PRIu64 " %016" PRIx64 " %s\n",
+                entry->tracked ? 'S' : 'F', entry->stats.size, entry->stats.mtime, entry->stats.inode, entry->hash, he->key);
+        PathList* dep = entry->tracked ? entry->deps : NULL;
+        while (dep != NULL) {
+            fprintf(fp, "D %s\n", dep->str);
+            dep = (PathList*)dep->next;
+        }
+    }
+    fclose(fp);
+    if (!replacefile(MANIFEST_PATH ".tmp", MANIFEST_PATH)) {
+        crash("Unable to replace build manifest");
+    }
+}
+
+void manifest_prefetch() {
+    if (s_manifest.count == 0) return;
+    uint64_t traced = microtime();
+    const char** files = malloc(s_manifest.count * sizeof(const char*));
+    ManifestEntry** entries = malloc(s_manifest.count * sizeof(ManifestEntry*));
+    FileStats* stats = malloc(s_manifest.count * sizeof(FileStats));
+    int* found = malloc(s_manifest.count * sizeof(int));
+    size_t count = 0;
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        HashEntry* he = &(s_manifest.entries[i]);
+        if (!he->key || ((ManifestEntry*)he->value)->status != MANIFEST_UNKNOWN) continue;
+        files[count] = he->key;
+        entries[count] = (ManifestEntry*)he->value;
+        count++;
+    }
+    filestats_batch(files, stats, found, count);
+    for (size_t i = 0; i < count; i++) {
+        entries[i]->current = stats[i];
+        entries[i]->prefetched = found[i] ? 1 : -1;
+    }
+    free(files);
+    free(entries);
+    free(stats);
+    free(found);
+    trace_phase("Prefetching file stats", traced);
+}
+
+void manifest_settle() {
+    PathList* pending = s_pending_headers;
+    while (pending != NULL) {
+        manifest_commit(manifest_entry(pending->str));
+        pending = (PathList*)pending->next;
+    }
+    pathlist_delete(s_pending_headers);
+    s_pending_headers = NULL;
+    manifest_save();
+}
+
+InventoryDir* inventory_dir(const char* path) {
+    InventoryDir* dir = (InventoryDir*)hashmap_get(&s_inventory, path);
+    if (!dir) {
+        dir = calloc(1, sizeof(InventoryDir));
+        hashmap_put(&s_inventory, path, dir);
+    }
+    return dir;
+}
+
+void inventory_load() {
+    FileStats saved = { 0 };
+    if (!filestats(INVENTORY_PATH, &saved)) return;
+    FILE* fp = fopen(INVENTORY_PATH, "r");
+    if (!fp) return;
+    char line[PATHLEN * 2] = { 0 };
+    int version = 0;
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "TINY INVENTORY %d", &version) != 1 || version != INVENTORY_VERSION) {
+        fclose(fp);
+        return;
+    }
+    InventoryDir* last = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        for (int i = strlen(line) - 1; i >= 0; i--) {
+            if (line[i] == '\n' || line[i] == '\r') {
+                line[i] = '\0';
+            } else break;
+        }
+        if ((line[0] == 'F' || line[0] == 'S') && line[1] == ' ' && last != NULL) {
+            pathlist_add(line[0] == 'F' ? &(last->files) : &(last->dirs), line + 2);
+            continue;
+        }
+        uint64_t recorded = 0;
+        int offset = 0;
+        if (line[0] != 'D' || sscanf(line + 1, " %" SCNu64 " %n", &recorded, &offset) != 1 || line[offset + 1] == '\0') {
+            last = NULL;
+            continue;
+        }
+        last = inventory_dir(line + offset + 1);
+        // a directory modified just before the snapshot was written could have changed
+        // again within the same timestamp tick, so only trust mtimes that are older
+        last->mtime = recorded + INVENTORY_RACY_WINDOW < saved.mtime ? recorded : 0;
+    }
+    fclose(fp);
+}
+
+void inventory_save() {
+    for (size_t i = 0; i < s_inventory.capacity; i++) {
+        HashEntry* he = &(s_inventory.entries[i]);
+        if (he->key && !((InventoryDir*)he->value)->scanned) s_inventory_dirty = 1;
+    }
+    if (!s_inventory_dirty) return;
+    FILE* fp = fopen(INVENTORY_PATH ".tmp", "w");
+    if (!fp) {
+        crash("Unable to write project inventory");
+    }
+    fprintf(fp, "TINY INVENTORY %d\n", INVENTORY_VERSION);
+    for (size_t i = 0; i < s_inventory.capacity; i++) {
+        HashEntry* he = &(s_inventory.entries[i]);
+        if (!he->key || !((InventoryDir*)he->value)->scanned) continue;
+        InventoryDir* dir = (InventoryDir*)he->value;
+        fprintf(fp, "D %" PRIu64 " %s\n", dir->mtime, he->key);
+        for (PathList* sub = dir->dirs; sub != NULL; sub = (PathList*)sub->next) {
+            fprintf(fp, "S %s\n", sub->str);
+        }
+        for (PathList* file = dir->files; file != NULL; file = (PathList*)file->next) {
+            fprintf(fp, "F %s\n", file->str);
+        }
+    }
+    fclose(fp);
+    if (!replacefile(INVENTORY_PATH ".tmp", INVENTORY_PATH)) {
+        crash("Unable to replace project inventory");
+    }
+    s_inventory_dirty = 0;
+}
+
+void inventory_scan(const char* path) {
+    InventoryDir* dir = inventory_dir(path);
+    if (dir->scanned) return;
+    dir->scanned = 1;
+    uint64_t current = 0;
+    if (!dirmtime(path, &current)) {
+        crash("Unable to open directory \"%s\"", path);
+    }
+    if (dir->mtime == 0 || dir->mtime != current) {
+        pathlist_delete(dir->files);
+        pathlist_delete(dir->dirs);
+        dir->files = NULL;
+        dir->dirs = NULL;
+        if (!listdir(path, &(dir->files), &(dir->dirs))) {
+            crash("Unable to open directory \"%s\"", path);
+        }
+        dir->mtime = current;
+        s_inventory_dirty = 1;
+    }
+    PathList* sub = dir->dirs;
+    while (sub != NULL) {
+        inventory_scan(sub->str);
+        sub = (PathList*)sub->next;
+    }
+}
+
+void inventory_build() {
+    if (s_inventory_ready) return;
+    s_inventory_ready = 1;
+    uint64_t traced = microtime();
+    if (s_inventory.count == 0) inventory_load();
+    PathList* curr = s_projects;
+    while (curr != NULL) {
+        inventory_scan(curr->str);
+        curr = (PathList*)curr->next;
+    }
+    inventory_save();
+    trace_phase("Taking project inventory", traced);
+}
+
+void inventory_walk(const char* path, FileHandler dirfunc, FileHandler filefunc) {
+    InventoryDir* dir = (InventoryDir*)hashmap_get(&s_inventory, path);
+    if (dir == NULL) return;
+    PathList* curr = filefunc != NULL ? dir->files : NULL;
+    while (curr != NULL) {
+        filefunc(curr->str);
+        curr = (PathList*)curr->next;
+    }
+    curr = dir->dirs;
+    while (curr != NULL) {
+        if (dirfunc != NULL) dirfunc(curr->str);
+        inventory_walk(curr->str, dirfunc, filefunc);
+        curr = (PathList*)curr->next;
+    }
+}
+
+void watch_file(const char* path) {
+    if (hashmap_get(&s_watched_files, path)) return;
+    FileStats* stats = malloc(sizeof(FileStats));
+    if (!filestats(path, stats)) {
+        free(stats);
+        return;
+    }
+    hashmap_put(&s_watched_files, path, stats);
+}
+
+void watch_directory(const char* path) {
+    if (hashmap_get(&s_watched_dirs, path)) return;
+    uint64_t* stamp = malloc(sizeof(uint64_t));
+    if (!dirmtime(path, stamp)) {
+        free(stamp);
+        return;
+    }
+    hashmap_put(&s_watched_dirs, path, stamp);
+}
+
+uint64_t state_signature(int argc, char* argv[]) {
+    int version[3] = { VERSION, MAJOR_RELEASE, MINOR_RELEASE };
+    uint64_t signature = fnv1a(version, sizeof(version), 0xcbf29ce484222325ULL);
+    char directory[PATHLEN] = { 0 };
+    if (cwd(directory) != NULL) signature = fnv1a(directory, strlen(directory) + 1, signature);
+    for (int i = 1; i < argc; i++) {
+        // the daemon builds on behalf of clients that do not pass --daemon
+        if (strcmp(argv[i], "--daemon") == 0 || strcmp(argv[i], "-daemon") == 0) continue;
+        signature = fnv1a(argv[i], strlen(argv[i]) + 1, signature);
+    }
+    return signature;
+}
+
+int state_current(int argc, char* argv[], unsigned* flags) {
+    size_t size = 0;
+    int mapped = 0;
+    const char* data = mapfile(STATE_PATH, &size, &mapped);
+    if (data == NULL) return 0;
+    const char* end = data + size;
+    char* cursor = NULL;
+    int version = 0;
+    uint64_t signature = 0;
+    unsigned saved = 0;
+    char path[PATHLEN] = { 0 };
+    const char* line = size > 0 ? memchr(data, '\n', size) : NULL;
+    int fresh = line != NULL && data[size - 1] == '\n' && (size_t)(line - data) < PATHLEN;
+    if (fresh) {
+        memcpy(path, data, line - data);
+        path[line - data] = '\0';
+        line++;
+        fresh = sscanf(path, "TINY STATE %d %" SCNx64 " %u", &version, &signature, &saved) == 3 && version == STATE_VERSION &&
+                signature == state_signature(argc, argv);
+    }
+    while (fresh && line < end) {
+        // every record is "<kind> <numbers...> <path>\n"
+        char kind = line[0];
+        FileStats recorded = { 0 };
+        recorded.size = kind == 'I' ? strtoull(line + 1, &cursor, 10) : 0;
+        recorded.mtime = strtoull(kind == 'I' ? cursor : line + 1, &cursor, 10);
+        if (kind == 'I') recorded.inode = strtoull(cursor, &cursor, 10);
+        const char* newline = memchr(cursor, '\n', end - cursor);
+        size_t length = newline - cursor - 1;
+        if (*cursor != ' ' || length == 0 || length >= PATHLEN) break;
+        memcpy(path, cursor + 1, length);
+        path[length] = '\0';
+        if (kind == 'D') {
+            uint64_t current = 0;
+            fresh = dirmtime(path, &current) && current == recorded.mtime;
+        } else if (kind == 'I') {
+            FileStats current = { 0 };
+            fresh = filestats(path, &current) && current.size == recorded.size &&
+                    current.mtime == recorded.mtime && current.inode == recorded.inode;
+        } else {
+            fresh = 0;
+        }
+        line = newline + 1;
+    }
+    fresh = fresh && line == end;
+    unmapfile(data, size, mapped);
+    if (flags != NULL) *flags = saved;
+    return fresh;
+}
+
+int state_fresh(int argc, char* argv[]) {
+    if (s_flags & (AUDIT | RECOMPILE_VENDORS | WATCH | PROFILE)) return 0;
+    unsigned flags = 0;
+    // watch builds save their state even when they fail, so never trust one here
+    int fresh = state_current(argc, argv, &flags) && !(flags & (AUDIT | RECOMPILE_VENDORS | WATCH));
+    if (fresh && (flags & RUN) && !(s_flags & RUN)) {
+        char run[] = "-r";
+        parseflag(run, 0);
+    }
+    return fresh;
+}
+
+void state_save(int argc, char* argv[]) {
+    FILE* fp = fopen(STATE_PATH ".tmp", "w");
+    if (!fp) {
+        crash("Unable to write build state");
+    }
+    fprintf(fp, "TINY STATE %d %016" PRIx64 " %u\n", STATE_VERSION, state_signature(argc, argv), (unsigned)s_flags);
+    for (size_t i = 0; i < s_watched_dirs.capacity; i++) {
+        HashEntry* he = &(s_watched_dirs.entries[i]);
+        if (he->key) fprintf(fp, "D %" PRIu64 " %s\n", *(uint64_t*)he->value, he->key);
+    }
+    for (size_t i = 0; i < s_inventory.capacity; i++) {
+        HashEntry* he = &(s_inventory.entries[i]);
+        if (he->key && ((InventoryDir*)he->value)->scanned) fprintf(fp, "D %" PRIu64 " %s\n", ((InventoryDir*)he->value)->mtime, he->key);
+    }
+    // inputs are written in path order so the next check walks each directory once
+    const char** inputs = malloc((s_watched_files.count + s_manifest.count) * sizeof(const char*));
+    size_t count = 0;
+    for (size_t i = 0; i < s_watched_files.capacity; i++) {
+        if (s_watched_files.entries[i].key) inputs[count++] = s_watched_files.entries[i].key;
+    }
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        HashEntry* he = &(s_manifest.entries[i]);
+        if (!he->key || strncmp(he->key, "build/cache/", 12) == 0 || hashmap_get(&s_watched_files, he->key)) continue;
+        ManifestEntry* entry = (ManifestEntry*)he->value;
+        if (entry->recorded && entry->prefetched >= 0) inputs[count++] = he->key;
+    }
+    qsort(inputs, count, sizeof(const char*), compare_paths);
+    for (size_t i = 0; i < count; i++) {
+        FileStats* stats = (FileStats*)hashmap_get(&s_watched_files, inputs[i]);
+        if (stats == NULL) stats = &(((ManifestEntry*)hashmap_get(&s_manifest, inputs[i]))->stats);
+        // a failed build records what is on disk so watch mode waits for the next edit
+        FileStats current = { 0 };
+        if (s_build_failed) {
+            if (!filestats(inputs[i], &current)) continue;
+            stats = &current;
+        }
+        fprintf(fp, "I %" PRIu64 " %" PRIu64 " %" PRIu64 " %s\n", stats->size, stats->mtime, stats->inode, inputs[i]);
+    }
+    free(inputs);
+    FileStats executable = { 0 };
+    if (filestats("build/bin.exe", &executable)) {
+        fprintf(fp, "I %" PRIu64 " %" PRIu64 " %" PRIu64 " build/bin.exe\n", executable.size, executable.mtime, executable.inode);
+    }
     fclose(fp);
+    if (!replacefile(STATE_PATH ".tmp", STATE_PATH)) {
+        crash("Unable to replace build state");
+    }
+}
+
+void affirmdir(const char* dir) {
+    if (!dexists(dir) && !rmakedir(dir)) {
+        crash("Unable to affirm directory %s", dir);
+    }
+}
+
+void affirm_to_cache(const char* dir) {
+    if (strstr(dir, "build/cache") == &(dir[0]) || strstr(dir, "./build/cache") == &(dir[0])) return;
+    char buffer[PATHLEN] = { 0 };
+    snprintf(buffer, PATHLEN, "build/cache/%s", dir);
+    affirmdir(buffer);
+}
+
+void add_to_sources(const char* file) {
+    if (strstr(file, "build/cache") == &(file[0]) || strstr(file, "./build/cache") == &(file[0])) return;
+    size_t slen = strlen(file);
+    if (slen > 2 && file[slen - 1] == 'c' && file[slen - 2] == '.')
+        pathlist_add(&s_sources, file);
 }
 
 void async_compile_progress_update(int index, int action, const char* name) {
     if (action == 0) {
         print("- [%s] \033[33m(compiling...)\033[0m", name);
     } else {
-        print("\033[%dA\033[2K- [%s] \033[32mOK\033[0m", s_sourcei - index, name);
+        print("\033[%dA\033[2K- [%s] \033[32mOK\033[0m%s", s_sourcei - index, name, action == 2 ? " (cached)" : "");
         printf("\033[%dB", (s_sourcei - index) - 1);
     }
 }
 
-void async_compile(void* params) {
-    ThreadParameters* tp = (ThreadParameters*)params;
-    int result = system(tp->command);
-    if (result == 0) {
-        copyfile(tp->file, tp->destination);
-        TINY_LOCK_MUTEX(s_mutex);
-        async_compile_progress_update(tp->sourcei, 1, tp->file + tp->basename_ptr);
-        TINY_RELEASE_MUTEX(s_mutex);
+uint64_t compiler_hash() {
+    affirmdir(STORE_PATH);
+    ArgList* command = calloc(1, sizeof(ArgList));
+    arglist_split(command, "gcc --version");
+    int result = runprocess(command, "the compiler version", STORE_PATH "/compiler.txt", NULL);
+    arglist_delete(command);
+    if (!result) {
+        crash("Unable to query the compiler version");
+    }
+    return hashfile(STORE_PATH "/compiler.txt");
+}
+
+uint64_t store_key(CompileJob* job, const char* preprocessed, const char* errors) {
+    ArgList* command = calloc(1, sizeof(ArgList));
+    for (size_t i = 0; i < job->command->count; i++) {
+        if (strcmp(job->command->argv[i], "-c") == 0) {
+            arglist_add(command, "-E");
+        } else if (i > 0 && strcmp(job->command->argv[i - 1], "-o") == 0) {
+            arglist_add(command, preprocessed);
+        } else {
+            arglist_add(command, job->command->argv[i]);
+        }
+    }
+    int result = runprocess(command, job->file, NULL, errors);
+    arglist_delete(command);
+    if (!result) return 0;
+    uint64_t key = s_compiler_hash;
+    for (size_t i = 0; i < job->command->count; i++) {
+        key = fnv1a_relocated(job->command->argv[i], strlen(job->command->argv[i]) + 1, s_cwd, key);
+    }
+    key = hashfile_relocated(preprocessed, s_cwd, key);
+    remove(preprocessed);
+    return key ? key : 1;
+}
+
+void store_path(uint64_t key, const char* extension, char* output) {
+    snprintf(output, PATHLEN, STORE_PATH "/%02x/%016" PRIx64 ".%s", (unsigned int)(key >> 56), key, extension);
+}
+
+void dumpfile(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return;
+    char buffer[4096];
+    size_t bytes;
+    fflush(stdout);
+    while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        fwrite(buffer, 1, bytes, stderr);
+    }
+    fflush(stderr);
+    fclose(fp);
+}
+
+void async_compile(CompileJob* job) {
+    uint64_t traced = microtime();
+    char preprocessed[PATHLEN + 4] = { 0 };
+    char errors[PATHLEN + 4] = { 0 };
+    char stored[PATHLEN] = { 0 };
+    char stored_errors[PATHLEN] = { 0 };
+    size_t stem = strlen(job->depfile) - 1;
+    snprintf(preprocessed, PATHLEN + 4, "%.*si", (int)stem, job->depfile);
+    snprintf(errors, PATHLEN + 4, "%.*slog", (int)stem, job->depfile);
+    if (s_flags & FAST) TINY_LOCK_MUTEX(s_mutex);
+    if (s_compiler_hash == 0) s_compiler_hash = compiler_hash();
+    if (s_flags & FAST) TINY_RELEASE_MUTEX(s_mutex);
+    // profiled compiles always run so every unit reports its timings
+    uint64_t key = (s_flags & PROFILE) ? 0 : store_key(job, preprocessed, errors);
+    int cached = 0;
+    int result = 0;
+    if (key) {
+        store_path(key, "o", stored);
+        store_path(key, "log", stored_errors);
+        cached = fexists(stored);
+    }
+    if (cached) {
+        touchfile(stored);
+        copyfile(stored, job->object);
+        if (fexists(stored_errors)) {
+            copyfile(stored_errors, errors);
+        } else if (fexists(errors)) {
+            remove(errors);
+        }
+        result = 1;
     } else {
+        result = runprocess(job->command, job->file, NULL, errors);
+        if (result && key) {
+            char directory[PATHLEN] = { 0 };
+            strcpy(directory, stored);
+            *strrchr(directory, '/') = '\0';
+            affirmdir(directory);
+            char staging[PATHLEN + 16] = { 0 };
+            snprintf(staging, PATHLEN + 16, "%s.%d.tmp", stored_errors, job->sourcei);
+            copyfile(errors, staging);
+            replacefile(staging, stored_errors);
+            snprintf(staging, PATHLEN + 16, "%s.%d.tmp", stored, job->sourcei);
+            copyfile(job->object, staging);
+            replacefile(staging, stored);
+        }
+    }
+    trace_job(job, traced, cached);
+    if (s_flags & FAST) TINY_LOCK_MUTEX(s_mutex);
+    if (s_flags & PROFILE) profile_collect(job, errors, microtime() - traced);
+    if (result) {
+        if (s_flags & FAST) {
+            async_compile_progress_update(job->sourcei, cached ? 2 : 1, job->file + job->basename_ptr);
+        } else {
+            print("\033[1A\033[0K- [%s] \033[32mOK\033[0m%s", job->file + job->basename_ptr, cached ? " (cached)" : "");
+        }
+        dumpfile(errors);
+        manifest_track((ManifestEntry*)job->entry, job->depfile);
+        if (job->pch) pathlist_add(&(((ManifestEntry*)job->entry)->deps), s_pch_stub);
+        manifest_commit((ManifestEntry*)job->entry);
+    } else {
+        dumpfile(errors);
+        print("Building source \"%s\" \033[31mfailed\033[0m", job->file + job->basename_ptr);
+        if (!(s_flags & (WATCH | DAEMON))) {
+            manifest_save();
+            exit(1);
+        }
+        s_build_failed = 1;
+    }
+    if (s_flags & FAST) TINY_RELEASE_MUTEX(s_mutex);
+    arglist_delete(job->command);
+    free(job);
+}
+
+void compile_worker(void* params) {
+    TINY_LOCK_MUTEX(s_mutex);
+    while (1) {
+        while (s_job_queue == NULL && !s_pool_closing) {
+            TINY_WAIT_COND(s_job_cond, s_mutex);
+        }
+        if (s_job_queue == NULL) break;
+        if (s_load_limit > 0 && s_jobs_running > 0 && loadaverage() > s_load_limit) {
+            TINY_RELEASE_MUTEX(s_mutex);
+            TINY_SLEEP(250);
+            TINY_LOCK_MUTEX(s_mutex);
+            continue;
+        }
+        CompileJob* job = s_job_queue;
+        s_job_queue = (CompileJob*)job->next;
+        if (s_job_queue == NULL) s_job_queue_tail = NULL;
+        s_jobs_running++;
+        TINY_RELEASE_MUTEX(s_mutex);
+        job->lane = (int)(intptr_t)params;
+        async_compile(job);
         TINY_LOCK_MUTEX(s_mutex);
-        print("Building source \"%s\" \033[31mfailed\033[0m", tp->file + tp->basename_ptr);
-        exit(1);
+        s_jobs_running--;
+        s_jobs_pending--;
+        if (s_jobs_pending == 0) TINY_BROADCAST_COND(s_done_cond);
+    }
+    TINY_RELEASE_MUTEX(s_mutex);
+}
+
+void pool_start() {
+    if (s_threads != NULL) return;
+    s_thread_count = s_jobs > 0 ? s_jobs : threadcount();
+    print("Enabling multi-threaded building over %d workers...", s_thread_count);
+    if (s_load_limit > 0) {
+        #ifdef __WIN32
+            warn("Load average throttling is not supported on Windows - ignoring \"-l %.2f\"", s_load_limit);
+            s_load_limit = 0;
+        #else
+            print("Holding back new jobs while the load average is above %.2f...", s_load_limit);
+        #endif
+    }
+    TINY_CREATE_MUTEX(s_mutex);
+    TINY_CREATE_COND(s_job_cond);
+    TINY_CREATE_COND(s_done_cond);
+    s_threads = calloc(s_thread_count, sizeof(TINY_THREAD));
+    for (int i = 0; i < s_thread_count; i++) {
+        TINY_CREATE_THREAD(s_threads[i], compile_worker, (void*)(intptr_t)(i + 1));
+    }
+}
+
+void pool_submit(CompileJob* job) {
+    TINY_LOCK_MUTEX(s_mutex);
+    job->next = NULL;
+    job->sourcei = s_sourcei;
+    job->queued = microtime();
+    s_sourcei++;
+    async_compile_progress_update(job->sourcei, 0, job->file + job->basename_ptr);
+    if (s_job_queue_tail) {
+        s_job_queue_tail->next = job;
+    } else {
+        s_job_queue = job;
+    }
+    s_job_queue_tail = job;
+    s_jobs_pending++;
+    TINY_SIGNAL_COND(s_job_cond);
+    TINY_RELEASE_MUTEX(s_mutex);
+}
+
+void pool_wait() {
+    TINY_LOCK_MUTEX(s_mutex);
+    while (s_jobs_pending > 0) {
+        TINY_WAIT_COND(s_done_cond, s_mutex);
     }
+    TINY_RELEASE_MUTEX(s_mutex);
+}
+
+void pool_stop() {
+    if (s_threads == NULL) return;
     TINY_LOCK_MUTEX(s_mutex);
-    s_active_threads[tp->index] = 2;
+    s_pool_closing = 1;
+    TINY_BROADCAST_COND(s_job_cond);
     TINY_RELEASE_MUTEX(s_mutex);
-    free(tp->command);
-    free(tp);
+    for (int i = 0; i < s_thread_count; i++) {
+        TINY_WAIT_THREAD(s_threads[i]);
+    }
+    free(s_threads);
+    s_threads = NULL;
 }
 
 void compile_source(const char* file) {
@@ -1524,8 +3954,6 @@ void compile_source(const char* file) {
             break;
         }
     }
-    char destination[PATHLEN] = { 0 };
-    snprintf(destination, PATHLEN, "build/cache/%s", file);
     if (strcmp(file + basename_ptr, s_main_file_name) == 0) {
         if (strcmp(s_main_file_path, file) != 0) {
             if (s_found_main) {
@@ -1534,108 +3962,117 @@ void compile_source(const char* file) {
             s_found_main = 1;
             strcpy(s_main_file_path, file);
         }
-        if (!fexists(destination) || !filecmp(destination, file)) {
-            copyfile(file, destination);
-            s_main_up_to_date = 0;
+        s_main_scheduled = 1;
+    }
+    char object[PATHLEN] = { 0 };
+    object_path("build/cache", file, object);
+    if (s_flags & UNITY) {
+        if (fexists(object)) remove(object);
+        pathlist_add(&s_unity_sources, file);
+        return;
+    }
+    compile_unit(file, object, 0);
+}
+
+ArgList* base_template() {
+    if (s_base_template) return s_base_template;
+    s_base_template = calloc(1, sizeof(ArgList));
+    arglist_add(s_base_template, "gcc");
+    arglist_extend(s_base_template, s_defines, 0);
+    arglist_split(s_base_template, "-Wall -Wextra -Wno-unused-parameter");
+    arglist_add(s_base_template, s_prefix_map);
+    return s_base_template;
+}
+
+ArgList* compile_template(int vendor) {
+    if (s_compile_templates[vendor]) return s_compile_templates[vendor];
+    ArgList* template = arglist_template(base_template());
+    arglist_extend(template, s_includes, 0);
+    if (!vendor && s_pch_stub[0] != '\0') {
+        arglist_add(template, "-include");
+        arglist_add(template, s_pch_stub);
+    }
+    arglist_extend(template, s_libs, 0);
+    arglist_extend(template, s_links, 1);
+    arglist_extend(template, s_raws, 1);
+    if (s_flags & PROD) arglist_split(template, vendor ? "-O3 -DPROD_BUILD" : "-O3 -flto -DPROD_BUILD");
+    if (s_flags & PROFILE) arglist_split(template, "-ftime-report -H");
+    s_compile_templates[vendor] = template;
+    return template;
+}
+
+void compile_unit(const char* file, const char* object, int vendor) {
+    int basename_ptr = 0;
+    for (int i = strlen(file); i > 0; i--) {
+        if (file[i] == '/' || file[i] == '\\') {
+            basename_ptr = i + 1;
+            break;
+        }
+    }
+    char depfile[PATHLEN + 2] = { 0 };
+    strcpy(depfile, object);
+    char* sep = strrchr(depfile, '/');
+    *sep = '\0';
+    affirmdir(depfile);
+    *sep = '/';
+    depfile[strlen(depfile) - 1] = 'd';
+    ArgList* command = arglist_template(compile_template(vendor));
+    arglist_add(command, "-c");
+    arglist_add(command, file);
+    arglist_add(command, "-o");
+    arglist_add(command, object);
+    arglist_add(command, "-MMD");
+    arglist_add(command, "-MF");
+    arglist_add(command, depfile);
+    if (s_flags & FAST) TINY_LOCK_MUTEX(s_mutex);
+    ManifestEntry* entry = NULL;
+    if (manifest_stale(file) || !fexists(object) || (vendor && (s_flags & RECOMPILE_VENDORS)) || (s_flags & PROFILE)) entry = manifest_entry(file);
+    if (s_flags & FAST) TINY_RELEASE_MUTEX(s_mutex);
+    if (entry) {
+        s_sources_up_to_date = 0;
+        CompileJob* job = calloc(1, sizeof(CompileJob));
+        job->command = command;
+        job->entry = entry;
+        job->basename_ptr = basename_ptr;
+        job->pch = !vendor && s_pch_stub[0] != '\0';
+        strcpy(job->file, file);
+        strcpy(job->object, object);
+        strcpy(job->depfile, depfile);
+        if (s_flags & FAST) {
+            pool_submit(job);
+        } else {
+            print("- [%s] \033[33m(compiling...)\033[0m", file + basename_ptr);
+            async_compile(job);
         }
     } else {
-        if (fexists(destination)) {
-            FILE* fp = fopen(file, "r");
-            if (!fp) {
-                crash("Unable to open file \"%s\"", file);
-            }
-            char line[PATHLEN * 2] = { 0 };
-            while (fgets(line, sizeof(line), fp)) {
-                if (strstr(line, "#include") != NULL) {
-                    PathList* curr = s_changed_headers;
-                    int breakagain = 0;
-                    while (curr != NULL) {
-                        if (strstr(line, curr->str) != NULL) {
-                            remove(destination);
-                            breakagain = 1;
-                            break;
-                        }
-                        curr = (PathList*)curr->next;
-                    }
-                    if (breakagain) break;
-                }
-            }
-            fclose(fp);
-        }
-        char* incbuf = calloc(pathlist_len(s_includes), PATHLEN);
-        char* linkbuf = calloc(pathlist_len(s_links), PATHLEN);
-        char* rawbuf = calloc(pathlist_len(s_raws), PATHLEN);
-        char* libbuf = calloc(pathlist_len(s_libs), PATHLEN);
-        char* defbuf = calloc(pathlist_len(s_defines), PATHLEN);
-        pathlist_construct(s_includes, incbuf);
-        pathlist_construct(s_links, linkbuf);
-        pathlist_construct(s_raws, rawbuf);
-        pathlist_construct(s_libs, libbuf);
-        pathlist_construct(s_defines, defbuf);
-        char* commandbuf = calloc(strlen(incbuf) + strlen(linkbuf) + strlen(libbuf) + PATHLEN, sizeof(char));
-        sprintf(
-            commandbuf,
-            "gcc %s-Wall -Wextra -Wno-unused-parameter -c %s %s%s%s-o %s.o %s %s",
-            defbuf,
-            file,
-            incbuf,
-            libbuf,
-            linkbuf,
-            destination,
-            rawbuf,
-            s_flags & PROD ? "-O3 -flto -DPROD_BUILD" : "");
-        if (!fexists(destination) || !filecmp(file, destination)) {
-            s_sources_up_to_date = 0;
-            if (s_flags & FAST) {
-                int ind = 0;
-                while (1) {
-                    TINY_LOCK_MUTEX(s_mutex);
-                    if (s_active_threads[ind] != 1) {
-                        if (s_active_threads[ind] == 2) {
-                            TINY_RELEASE_MUTEX(s_mutex);
-                            TINY_WAIT_THREAD(s_threads[ind]);
-                            TINY_LOCK_MUTEX(s_mutex);
-                        }
-                        s_active_threads[ind] = 1;
-                        ThreadParameters* tp = calloc(1, sizeof(ThreadParameters));
-                        tp->command = commandbuf;
-                        strcpy(tp->destination, destination);
-                        strcpy(tp->file, file);
-                        tp->index = ind;
-                        tp->basename_ptr = basename_ptr;
-                        tp->sourcei = s_sourcei;
-                        s_sourcei++;
-                        async_compile_progress_update(s_sourcei - 1, 0, file + basename_ptr);
-                        TINY_CREATE_THREAD(s_threads[ind], async_compile, tp);
-                        TINY_RELEASE_MUTEX(s_mutex);
-                        break;
-                    }
-                    TINY_RELEASE_MUTEX(s_mutex);
-                    ind++;
-                    if (ind >= threadcount()) ind = 0;
-                }
-            } else {
-                print("- [%s] \033[33m(compiling...)\033[0m", file + basename_ptr);
-                int result = system(commandbuf);
-                if (result == 0) {
-                    print("\033[1A\033[0K- [%s] \033[32mOK\033[0m", file + basename_ptr);
-                    copyfile(file, destination);
-                } else {
-                    print("Building source \"%s\" \033[31mfailed\033[0m", file + basename_ptr);
-                    exit(1);
-                }
-                free(commandbuf);
-            }
+        arglist_delete(command);
+    }
+    pathlist_add(&s_objects, object);
+}
+
+void object_path(const char* root, const char* file, char* output) {
+    char normalized[PATHLEN] = { 0 };
+    normalize_path(file, normalized);
+    size_t o = snprintf(output, PATHLEN, "%s/", root);
+    const char* c = normalized;
+    while (*c == '/') c++;
+    while (*c != '\0' && o < PATHLEN - 3) {
+        if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0')) {
+            output[o++] = '_';
+            output[o++] = '_';
+            c += 2;
+        } else {
+            output[o++] = *c == ':' ? '_' : *c;
+            c++;
         }
-        char finalbuf[PATHLEN + 2] = { 0 };
-        snprintf(finalbuf, PATHLEN + 2, "%s.o", destination);
-        pathlist_add(&s_objects, finalbuf);
-        free(incbuf);
-        free(linkbuf);
-        free(rawbuf);
-        free(libbuf);
-        free(defbuf);
     }
+    output[o] = '\0';
+    strncat(output, ".o", PATHLEN - o - 1);
+}
+
+int valueflag(const char* flag) {
+    return strcmp("-j", flag) == 0 || strcmp("-jobs", flag) == 0 || strcmp("-l", flag) == 0 || strcmp("-load", flag) == 0 ||
+           strcmp("--trace", flag) == 0 || strcmp("-trace", flag) == 0;
 }
 
 void parseflag(char* flag, int blacklistable) {
@@ -1646,21 +4083,25 @@ void parseflag(char* flag, int blacklistable) {
         return;
     }
     char buffer[PATHLEN] = { 0 };
+    char* value = NULL;
     int whitelist = 1;
     if (blacklistable) {
         for (size_t i = 0; i < strlen(flag); i++) {
             if (flag[i] == '=') {
-                if (strcmp(flag + i + 1, "true") == 0 || strcmp(flag + i + 1, "TRUE") == 0) {
-                    whitelist = 1;
-                } else if (strcmp(flag + i + 1, "false") == 0 || strcmp(flag + i + 1, "FALSE") == 0) {
-                    whitelist = 0;
-                } else {
-                    crash("Unknown equal argument in flag \"%s\" - \"%s\"", flag, flag + i + 1);
-                }
+                value = flag + i + 1;
                 break;
             }
             buffer[i] = flag[i];
         }
+        if (value && !valueflag(buffer)) {
+            if (strcmp(value, "true") == 0 || strcmp(value, "TRUE") == 0) {
+                whitelist = 1;
+            } else if (strcmp(value, "false") == 0 || strcmp(value, "FALSE") == 0) {
+                whitelist = 0;
+            } else {
+                crash("Unknown equal argument in flag \"%s\" - \"%s\"", flag, value);
+            }
+        }
     } else {
         strcpy(buffer, flag);
     }
@@ -1684,14 +4125,52 @@ void parseflag(char* flag, int blacklistable) {
         }
     } else if (strcmp("-f", buffer) == 0 || strcmp("-fast", buffer) == 0) {
         if (whitelist && !(s_unflags & FAST)) {
-            print("Enabling multi-threaded building over %d cores...", threadcount());
-            s_threads = calloc(threadcount(), sizeof(TINY_THREAD));
-            s_active_threads = calloc(threadcount(), sizeof(int));
-            TINY_CREATE_MUTEX(s_mutex);
             s_flags |= FAST;
         } else {
             s_unflags |= FAST;
         }
+    } else if (strcmp("-j", buffer) == 0 || strcmp("-jobs", buffer) == 0) {
+        int jobs = value ? atoi(value) : 0;
+        if (jobs <= 0) {
+            crash("Invalid job count \"%s\" - expected a positive number such as \"-j 8\"", value ? value : "");
+        }
+        s_jobs = jobs;
+        if (jobs > 1 && !(s_unflags & FAST)) s_flags |= FAST;
+    } else if (strcmp("-l", buffer) == 0 || strcmp("-load", buffer) == 0) {
+        double load = value ? atof(value) : 0;
+        if (load <= 0) {
+            crash("Invalid load average limit \"%s\" - expected a positive number such as \"-l 12\"", value ? value : "");
+        }
+        s_load_limit = load;
+    } else if (strcmp("--trace", buffer) == 0 || strcmp("-trace", buffer) == 0) {
+        if (!value || value[0] == '\0') {
+            crash("Missing trace file - expected a path such as \"--trace build/trace.json\"");
+        }
+        strncpy(s_trace_path, value, PATHLEN - 1);
+    } else if (strcmp("--profile-compile", buffer) == 0 || strcmp("-profile-compile", buffer) == 0) {
+        if (whitelist && !(s_unflags & PROFILE)) {
+            s_flags |= PROFILE;
+        } else {
+            s_unflags |= PROFILE;
+        }
+    } else if (strcmp("--daemon", buffer) == 0 || strcmp("-daemon", buffer) == 0) {
+        if (whitelist && !(s_unflags & DAEMON)) {
+            s_flags |= DAEMON;
+        } else {
+            s_unflags |= DAEMON;
+        }
+    } else if (strcmp("-w", buffer) == 0 || strcmp("-watch", buffer) == 0) {
+        if (whitelist && !(s_unflags & WATCH)) {
+            s_flags |= WATCH;
+        } else {
+            s_unflags |= WATCH;
+        }
+    } else if (strcmp("-u", buffer) == 0 || strcmp("-unity", buffer) == 0) {
+        if (whitelist && !(s_unflags & UNITY)) {
+            s_flags |= UNITY;
+        } else {
+            s_unflags |= UNITY;
+        }
     } else if (strcmp("-d", buffer) == 0 || strcmp("-debug", buffer) == 0) {
         if (whitelist && !(s_unflags & DEBUG)) {
             s_flags |= DEBUG;
@@ -1716,6 +4195,7 @@ void parseflag(char* flag, int blacklistable) {
         }
     } else if (strcmp("-c", buffer) == 0 || strcmp("-clean", buffer) == 0) {
         if (whitelist && !(s_unflags & CLEAN)) {
+            build_lock();
             if (dexists("build/cache")) {
                 print("Cleaning cache...");
                 rmtree("build/cache");
@@ -1737,11 +4217,13 @@ void configure(const char* prepath, const char* path) {
     if (!file) {
         crash("Unable to open configuration file \"%s\"", path);
     }
+    watch_file(path);
     char line[PATHLEN * 2] = { 0 };
     char precursor[PATHLEN] = { 0 };
     char workbuffer[PATHLEN] = { 0 };
     int linecount = 0;
     while (fgets(line, sizeof(line), file)) {
+        linecount++;
         for (int i = strlen(line) - 1; i >= 0; i--) {
             if (line[i] == '\n' || line[i] == '\r') {
                 line[i] = '\0';
@@ -1824,17 +4306,25 @@ void configure(const char* prepath, const char* path) {
                 strcpy(s_main_file_name, line + postcursor);
             }
         } else if (strcmp(precursor, "INCLUDE") == 0) {
-            snprintf(workbuffer, PATHLEN, "-I\"%s%s\"", prepath, line + postcursor);
+            char b[PATHLEN] = { 0 };
+            snprintf(b, PATHLEN, "%s%s", prepath, line + postcursor);
+            arglist_unquote(workbuffer + 2, b, PATHLEN - 2);
+            memcpy(workbuffer, "-I", 2);
             pathlist_add(&s_includes, workbuffer);
         } else if (strcmp(precursor, "LINK") == 0) {
             snprintf(workbuffer, PATHLEN, "-l%s", line + postcursor);
             pathlist_add(&s_links, workbuffer);
         } else if (strcmp(precursor, "LIB") == 0) {
-            snprintf(workbuffer, PATHLEN, "-L\"%s%s\"", prepath, line + postcursor);
+            char b[PATHLEN] = { 0 };
+            snprintf(b, PATHLEN, "%s%s", prepath, line + postcursor);
+            arglist_unquote(workbuffer + 2, b, PATHLEN - 2);
+            memcpy(workbuffer, "-L", 2);
             pathlist_add(&s_libs, workbuffer);
         } else if (strcmp(precursor, "SOURCE") == 0) {
             snprintf(workbuffer, PATHLEN, "%s%s", prepath, line + postcursor);
             if (dexists(workbuffer)) {
+                watch_directory(workbuffer);
+                walkdir(workbuffer, watch_directory);
                 walkfiles(workbuffer, add_to_sources);
             } else {
                 pathlist_add(&s_sources, workbuffer);
@@ -1847,8 +4337,23 @@ void configure(const char* prepath, const char* path) {
             snprintf(workbuffer, PATHLEN, "-framework %s", line + postcursor);
             pathlist_add(&s_links, workbuffer);
         } else if (strcmp(precursor, "DEFINE") == 0) {
-            snprintf(workbuffer, PATHLEN, "-D\"%s\"", line + postcursor);
+            arglist_unquote(workbuffer + 2, line + postcursor, PATHLEN - 2);
+            memcpy(workbuffer, "-D", 2);
             pathlist_add(&s_defines, workbuffer);
+        } else if (strcmp(precursor, "PCH") == 0) {
+            snprintf(workbuffer, PATHLEN, "%s%s", prepath, line + postcursor);
+            if (s_pch_header[0] != '\0' && strcmp(s_pch_header, workbuffer) != 0) {
+                crash("Only one precompiled header is supported, found \"%s\" and \"%s\"", s_pch_header, workbuffer);
+            }
+            strcpy(s_pch_header, workbuffer);
+        } else if (strcmp(precursor, "CACHE_LIMIT") == 0) {
+            s_cache_limit = parsesize(line + postcursor);
+        } else if (strcmp(precursor, "JOBS") == 0) {
+            int jobs = atoi(line + postcursor);
+            if (jobs <= 0) {
+                crash("Invalid job count \"%s\" detected on line %d of \"%s\"", line + postcursor, linecount, path);
+            }
+            if (s_jobs == 0) s_jobs = jobs;
         } else if (strcmp(precursor, "RAW") == 0) {
             pathlist_add(&s_raws, line + postcursor);
         } else if (strcmp(precursor, "MODULE") == 0) {
@@ -1884,30 +4389,67 @@ void affirm_projects() {
         snprintf(tbuf, PATHLEN + 12, "build/cache/%s", curr->str);
         affirmdir(tbuf);
 
-        // set up cache folders
-        walkdir(curr->str, affirm_to_cache);
-
         // set up include directories
-        snprintf(tbuf, PATHLEN + 12, "-I\"%s\"", curr->str);
+        snprintf(tbuf, PATHLEN + 12, "-I%s", curr->str);
         pathlist_add(&s_includes, tbuf);
 
         curr = (PathList*)curr->next;
     }
+
+    // take the project inventory
+    inventory_build();
+
+    // set up cache folders
+    curr = s_projects;
+    while (curr != NULL) {
+        inventory_walk(curr->str, affirm_to_cache, NULL);
+        curr = (PathList*)curr->next;
+    }
 }
 
-void initialize(int argc, char* argv[]) {
+void parseflags(int argc, char* argv[]) {
     // initialize timer
     s_start_time = mtime();
+    s_trace_start = microtime();
 
     // parse flags
     for (int i = 1; i < argc; i++) {
-        parseflag(argv[i], 1);
+        if (!(s_flags & RUN) && valueflag(argv[i]) && i + 1 < argc) {
+            char joined[PATHLEN] = { 0 };
+            snprintf(joined, PATHLEN, "%s=%s", argv[i], argv[i + 1]);
+            parseflag(joined, 1);
+            i++;
+        } else {
+            parseflag(argv[i], 1);
+        }
     }
+}
+
+void initialize() {
+    prepare();
+
+    // set up build directories
+    affirmdir("build");
+    affirmdir("build/cache");
+    affirmdir("build/vendor");
+
+    // the project root is watched for a new main file or .tinyconf
+    watch_directory(".");
+
+    // load build manifest and stat everything it tracks in one batch
+    manifest_load();
+    manifest_prefetch();
+
+    // spin up compile workers
+    if (s_flags & FAST) pool_start();
+}
 
+void prepare() {
     // set up cwd
     if (cwd(s_cwd) == NULL) {
         crash("Unable to find the current working directory");
     }
+    snprintf(s_prefix_map, PATHLEN + 24, "-ffile-prefix-map=%s=.", s_cwd);
 
     // fallback main file name
     strcpy(s_main_file_name, "main.c");
@@ -1916,94 +4458,222 @@ void initialize(int argc, char* argv[]) {
     if (fexists(".tinyconf")) {
         configure("", ".tinyconf");
     }
-
-    // set up build directories
-    affirmdir("build");
-    affirmdir("build/cache");
-    affirmdir("build/vendor");
 }
 
 void compile_vendors() {
-    if (s_sources == NULL) return;
-    if (!fexists("build/vendor/vendor.o") || (s_flags & RECOMPILE_VENDORS)) {
-        print("Compiling vendors...");
-        FILE* file = fopen("build/vendor/tiny_merged_vendors.c", "w");
-        if (!file) {
-            crash("Unable to consolidate vendor sources");
-        }
-        PathList* pl = s_sources;
-        while (pl != NULL) {
-            char buffer[PATHLEN + 18] = { 0 };
-            snprintf(buffer, PATHLEN + 18, "#include \"../../%s\"\n", pl->str);
-            fprintf(file, buffer);
-            pl = (PathList*)pl->next;
-        }
-        fclose(file);
-        char* incbuf = calloc(pathlist_len(s_includes), PATHLEN);
-        char* linkbuf = calloc(pathlist_len(s_links), PATHLEN);
-        char* rawbuf = calloc(pathlist_len(s_raws), PATHLEN);
-        char* libbuf = calloc(pathlist_len(s_libs), PATHLEN);
-        char* defbuf = calloc(pathlist_len(s_defines), PATHLEN);
-        pathlist_construct(s_includes, incbuf);
-        pathlist_construct(s_links, linkbuf);
-        pathlist_construct(s_raws, rawbuf);
-        pathlist_construct(s_libs, libbuf);
-        pathlist_construct(s_defines, defbuf);
-        char* commandbuf = calloc(strlen(incbuf) + strlen(linkbuf) + strlen(libbuf) + PATHLEN, sizeof(char));
-        sprintf(
-            commandbuf,
-            "gcc %s-Wall -Wextra -Wno-unused-parameter -c build/vendor/tiny_merged_vendors.c %s%s%s-o build/vendor/vendor.o %s%s",
-            defbuf,
-            incbuf,
-            libbuf,
-            linkbuf,
-            rawbuf,
-            s_flags & PROD ? "-O3 -DPROD_BUILD" : "");
-        uint64_t timer = mtime();
-        int result = system(commandbuf);
-        if (result == 0) {
-            int hours, minutes;
-            float seconds;
-            dissect_time_elapsed(timer, &hours, &minutes, &seconds);
-            print("\033[32mFinished\033[0m compiling vendors in %d:%d:%.3f", hours, minutes, seconds);
-        } else {
-            print("Building vendors \033[31mfailed\033[0m");
+    if (fexists("build/vendor/vendor.o")) remove("build/vendor/vendor.o");
+    if (fexists("build/vendor/tiny_merged_vendors.c")) remove("build/vendor/tiny_merged_vendors.c");
+    PathList* curr = s_sources;
+    while (curr != NULL) {
+        char object[PATHLEN] = { 0 };
+        object_path("build/vendor", curr->str, object);
+        compile_unit(curr->str, object, 1);
+        curr = (PathList*)curr->next;
+    }
+}
+
+void compile_pch() {
+    if (s_pch_header[0] == '\0') return;
+    if (!fexists(s_pch_header)) {
+        crash("Unable to find precompiled header \"%s\"", s_pch_header);
+    }
+    ArgList* command = arglist_template(base_template());
+    arglist_extend(command, s_includes, 0);
+    arglist_extend(command, s_raws, 1);
+    if (s_flags & PROD) arglist_split(command, "-O3 -flto -DPROD_BUILD");
+    uint64_t signature = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < command->count; i++) {
+        signature = fnv1a_relocated(command->argv[i], strlen(command->argv[i]) + 1, s_cwd, signature);
+    }
+    char header[PATHLEN] = { 0 };
+    normalize_path(s_pch_header, header);
+    int basename_ptr = 0;
+    for (int i = strlen(header); i > 0; i--) {
+        if (header[i] == '/') {
+            basename_ptr = i + 1;
+            break;
+        }
+    }
+    char directory[PATHLEN] = { 0 };
+    snprintf(directory, PATHLEN, "build/cache/pch/%016" PRIx64, signature);
+    affirmdir(directory);
+    snprintf(s_pch_stub, PATHLEN, "%s/%s", directory, header + basename_ptr);
+    if (!fexists(s_pch_stub)) {
+        FILE* fp = fopen(s_pch_stub, "w");
+        if (!fp) {
+            crash("Unable to write precompiled header stub \"%s\"", s_pch_stub);
+        }
+        int absolute = header[0] == '/' || (header[0] != '\0' && header[1] == ':');
+        fprintf(fp, "#include \"%s%s\"\n", absolute ? "" : "../../../../", header);
+        fclose(fp);
+    }
+    char gch[PATHLEN + 4] = { 0 };
+    char depfile[PATHLEN + 4] = { 0 };
+    snprintf(gch, PATHLEN + 4, "%s.gch", s_pch_stub);
+    snprintf(depfile, PATHLEN + 4, "%s.d", s_pch_stub);
+    if (!manifest_stale(s_pch_stub) && fexists(gch)) {
+        arglist_delete(command);
+        return;
+    }
+    print("- [%s] \033[33m(precompiling...)\033[0m", header + basename_ptr);
+    arglist_split(command, "-x c-header");
+    arglist_add(command, s_pch_stub);
+    arglist_add(command, "-o");
+    arglist_add(command, gch);
+    arglist_split(command, "-MMD -MF");
+    arglist_add(command, depfile);
+    int result = runprocess(command, s_pch_stub, NULL, NULL);
+    arglist_delete(command);
+    if (!result) {
+        print("Precompiling header \"%s\" \033[31mfailed\033[0m", header + basename_ptr);
+        remove(gch);
+        if (!(s_flags & (WATCH | DAEMON))) {
+            manifest_save();
+            exit(1);
         }
-        free(commandbuf);
-        free(incbuf);
-        free(linkbuf);
-        free(rawbuf);
-        free(libbuf);
-        free(defbuf);
+        s_build_failed = 1;
+        return;
     }
-    pathlist_add(&s_objects, "build/vendor/vendor.o");
+    print("\033[1A\033[0K- [%s] \033[32mOK\033[0m", header + basename_ptr);
+    ManifestEntry* entry = manifest_entry(s_pch_stub);
+    manifest_track(entry, depfile);
+    manifest_commit(entry);
+}
+
+int compare_paths(const void* a, const void* b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+void compile_unity() {
+    if (!(s_flags & UNITY)) {
+        if (dexists("build/cache/unity")) rmtree("build/cache/unity");
+        return;
+    }
+    size_t count = pathlist_len(s_unity_sources);
+    if (count == 0) return;
+    size_t batches = 1;
+    while (batches * UNITY_BATCH_FILES < count) batches *= 2;
+    char** sorted = calloc(count, sizeof(char*));
+    PathList* curr = s_unity_sources;
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = calloc(PATHLEN, sizeof(char));
+        normalize_path(curr->str, sorted[i]);
+        curr = (PathList*)curr->next;
+    }
+    qsort(sorted, count, sizeof(char*), compare_paths);
+    PathList** members = calloc(batches, sizeof(PathList*));
+    for (size_t i = count; i > 0; i--) {
+        size_t batch = fnv1a(sorted[i - 1], strlen(sorted[i - 1]), 0xcbf29ce484222325ULL) & (batches - 1);
+        pathlist_add(&(members[batch]), sorted[i - 1]);
+        free(sorted[i - 1]);
+    }
+    free(sorted);
+    affirmdir("build/cache/unity");
+    char batchfile[PATHLEN] = { 0 };
+    char object[PATHLEN] = { 0 };
+    for (size_t i = 0; i < batches; i++) {
+        snprintf(batchfile, PATHLEN, "build/cache/unity/unity_%zu.c", i);
+        snprintf(object, PATHLEN, "build/cache/unity/unity_%zu.o", i);
+        if (members[i] == NULL) {
+            if (fexists(batchfile)) remove(batchfile);
+            if (fexists(object)) remove(object);
+            continue;
+        }
+        size_t len = 1;
+        PathList* member = members[i];
+        while (member != NULL) {
+            len += strlen(member->str) + 24;
+            member = (PathList*)member->next;
+        }
+        char* content = calloc(len, sizeof(char));
+        size_t o = 0;
+        member = members[i];
+        while (member != NULL) {
+            int absolute = member->str[0] == '/' || (member->str[0] != '\0' && member->str[1] == ':');
+            o += sprintf(content + o, "#include \"%s%s\"\n", absolute ? "" : "../../../", member->str);
+            member = (PathList*)member->next;
+        }
+        int unchanged = 0;
+        FILE* fp = fopen(batchfile, "rb");
+        if (fp) {
+            char* existing = calloc(o + 2, sizeof(char));
+            unchanged = fread(existing, 1, o + 1, fp) == o && memcmp(existing, content, o) == 0;
+            free(existing);
+            fclose(fp);
+        }
+        if (!unchanged) {
+            fp = fopen(batchfile, "wb");
+            if (!fp) {
+                crash("Unable to write unity batch \"%s\"", batchfile);
+            }
+            fwrite(content, 1, o, fp);
+            fclose(fp);
+        }
+        free(content);
+        pathlist_delete(members[i]);
+        compile_unit(batchfile, object, 0);
+    }
+    for (size_t i = batches; ; i++) {
+        snprintf(batchfile, PATHLEN, "build/cache/unity/unity_%zu.c", i);
+        snprintf(object, PATHLEN, "build/cache/unity/unity_%zu.o", i);
+        if (!fexists(batchfile) && !fexists(object)) break;
+        remove(batchfile);
+        remove(object);
+    }
+    free(members);
+    pathlist_delete(s_unity_sources);
+    s_unity_sources = NULL;
+}
+
+void add_dependent(const char* header, const char* source) {
+    PathList* dependents = (PathList*)hashmap_get(&s_dependents, header);
+    pathlist_add(&dependents, source);
+    hashmap_put(&s_dependents, header, dependents);
 }
 
 void calculate_dependencies() {
     print("Calculating dependency tree...");
     uint64_t timer = mtime();
-    PathList* curr = s_projects;
-    while (curr != NULL) {
-        walkfiles(curr->str, verify_header);
-        curr = (PathList*)curr->next;
-    }
-    if (s_changed_headers == NULL) {
-        print("\033[1A\033[0KHeaders are currently \033[32mup to date\033[0m");
-        return;
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        if (!s_manifest.entries[i].key) continue;
+        ManifestEntry* entry = (ManifestEntry*)s_manifest.entries[i].value;
+        PathList* dep = entry->tracked ? entry->deps : NULL;
+        while (dep != NULL) {
+            add_dependent(dep->str, s_manifest.entries[i].key);
+            dep = (PathList*)dep->next;
+        }
     }
-    while (1) {
-        PathList* current = s_changed_headers;
-        PathList* currproj = s_projects;
-        while (currproj != NULL) {
-            walkfiles(currproj->str, accumulate_header);
-            currproj = (PathList*)currproj->next;
+    size_t queue_len = 0;
+    const char** queue = calloc(s_dependents.count + s_manifest.count + 1, sizeof(char*));
+    for (size_t i = 0; i < s_dependents.capacity; i++) {
+        const char* header = s_dependents.entries[i].key;
+        if (header && manifest_changed(header)) {
+            pathlist_add(&s_changed_headers, header);
+            pathlist_add(&s_pending_headers, header);
+            hashmap_put(&s_dirty, header, (void*)header);
+            queue[queue_len++] = header;
+        }
+    }
+    for (size_t qi = 0; qi < queue_len; qi++) {
+        PathList* dependent = (PathList*)hashmap_get(&s_dependents, queue[qi]);
+        while (dependent != NULL) {
+            if (!hashmap_get(&s_dirty, dependent->str)) {
+                hashmap_put(&s_dirty, dependent->str, (void*)dependent->str);
+                queue[queue_len++] = dependent->str;
+            }
+            dependent = (PathList*)dependent->next;
         }
-        if (current == s_changed_headers) break;
     }
+    free(queue);
     int hours, minutes;
     float seconds;
     dissect_time_elapsed(timer, &hours, &minutes, &seconds);
-    print("\033[32mFinished\033[0m calculating depdencies in %d:%d:%.3f", hours, minutes, seconds);
+    if (s_changed_headers == NULL) {
+        print("\033[1A\033[0KHeaders are currently \033[32mup to date\033[0m (checked %d in %d:%d:%.3f)", (int)s_dependents.count, hours, minutes, seconds);
+        return;
+    }
+    print("\033[32mFinished\033[0m calculating dependencies in %d:%d:%.3f - %d changed headers affect %d files",
+        hours, minutes, seconds, (int)pathlist_len(s_changed_headers), (int)(s_dirty.count - pathlist_len(s_changed_headers)));
 }
 
 void compile_objects() {
@@ -2018,32 +4688,36 @@ void compile_objects() {
                 break;
             }
         }
-        snprintf(destination, PATHLEN, "build/cache/%s", s_main_file_name);
         strcpy(s_main_file_path, s_main_file_name);
         s_found_main = 1;
-        if (!fexists(destination) || !filecmp(destination, s_main_file_path)) {
-            copyfile(s_main_file_path, destination);
-            s_main_up_to_date = 0;
-        }
         snprintf(destination, PATHLEN, "%s", s_main_file_name + basename_ptr);
         strcpy(s_main_file_name, destination);
     }
+    uint64_t traced = microtime();
+    compile_pch();
+    if (s_pch_header[0] != '\0') trace_phase("Precompiling header", traced);
+    if (s_build_failed) return;
+    compile_vendors();
     PathList* curr = s_projects;
     while (curr != NULL) {
-        walkfiles(curr->str, compile_source);
+        inventory_walk(curr->str, NULL, compile_source);
         curr = (PathList*)curr->next;
     }
-    if (s_flags & FAST) {
-        while (1) {
-            int all_done = 1;
-            for (int i = 0; i < threadcount(); i++) {
-                TINY_LOCK_MUTEX(s_mutex);
-                if (s_active_threads[i] == 1) all_done = 0;
-                TINY_RELEASE_MUTEX(s_mutex);
-            }
-            if (all_done) break;
-        }
+    if (s_found_main && !s_main_scheduled) {
+        char object[PATHLEN] = { 0 };
+        object_path("build/cache", s_main_file_path, object);
+        compile_unit(s_main_file_path, object, 0);
     }
+    compile_unity();
+    if (s_flags & FAST) pool_wait();
+    if (s_build_failed) {
+        // leave changed headers unrecorded so their dependents are retried next build
+        pathlist_delete(s_pending_headers);
+        s_pending_headers = NULL;
+        manifest_save();
+        return;
+    }
+    manifest_settle();
     if (s_sources_up_to_date) {
         print("\033[1A\033[0KSources are currently \033[32mup to date\033[0m");
     } else {
@@ -2060,47 +4734,32 @@ void compile_objects() {
 void compile_executable() {
     print("Building executable...");
     uint64_t timer = mtime();
-    char* incbuf = calloc(pathlist_len(s_includes), PATHLEN);
-    char* linkbuf = calloc(pathlist_len(s_links), PATHLEN);
-    char* rawbuf = calloc(pathlist_len(s_raws), PATHLEN);
-    char* libbuf = calloc(pathlist_len(s_libs), PATHLEN);
-    char* objbuf = calloc(pathlist_len(s_objects), PATHLEN);
-    char* defbuf = calloc(pathlist_len(s_defines), PATHLEN);
-    pathlist_construct(s_includes, incbuf);
-    pathlist_construct(s_links, linkbuf);
-    pathlist_construct(s_libs, libbuf);
-    pathlist_construct(s_raws, rawbuf);
-    pathlist_construct(s_objects, objbuf);
-    pathlist_construct(s_defines, defbuf);
-    char* commandbuf = calloc(strlen(incbuf) + strlen(linkbuf) + strlen(libbuf) + strlen(objbuf) + PATHLEN, sizeof(char));
-    sprintf(
-        commandbuf,
-        "gcc %s-Wall -Wextra -Wno-unused-parameter %s %s%s%s%s-o build/bin.exe %s%s",
-        defbuf,
-        s_main_file_path,
-        objbuf,
-        incbuf,
-        libbuf,
-        linkbuf,
-        rawbuf,
-        s_flags & PROD ? "-O3 -DPROD_BUILD" : "");
-    if (s_flags & DEBUG) printf("\n\n==========DEBUG COMMAND BUFFER==========\n\n%s\n\n========END DEBUG COMMAND BUFFER========\n\n", commandbuf);
-    int result = system(commandbuf);
-    if (result == 0) {
+    ArgList* command = arglist_template(base_template());
+    arglist_extend(command, s_objects, 0);
+    arglist_extend(command, s_includes, 0);
+    arglist_extend(command, s_libs, 0);
+    arglist_extend(command, s_links, 1);
+    arglist_split(command, "-o build/bin.exe");
+    arglist_extend(command, s_raws, 1);
+    if (s_flags & PROD) arglist_split(command, "-O3 -flto -DPROD_BUILD");
+    if (s_flags & DEBUG) {
+        char* rendered = arglist_render(command);
+        printf("\n\n==========DEBUG COMMAND BUFFER==========\n\n%s\n\n========END DEBUG COMMAND BUFFER========\n\n", rendered);
+        free(rendered);
+    }
+    int result = runprocess(command, "the executable", NULL, NULL);
+    if (result) {
         int hours, minutes;
         float seconds;
         dissect_time_elapsed(timer, &hours, &minutes, &seconds);
         print("\033[32mFinished\033[0m compiling executable in %d:%d:%.3f", hours, minutes, seconds);
     } else {
         print("Building executable \033[31mfailed\033[0m");
-        exit(1);
+        remove("build/bin.exe");
+        if (!(s_flags & (WATCH | DAEMON))) exit(1);
+        s_build_failed = 1;
     }
-    free(commandbuf);
-    free(objbuf);
-    free(incbuf);
-    free(linkbuf);
-    free(libbuf);
-    free(rawbuf);
+    arglist_delete(command);
 }
 
 void get_in_depth_headers(const char* dive_header, HeaderLinkList* update_header) {
@@ -2131,7 +4790,7 @@ void audit() {
     uint64_t timer = mtime();
     PathList* currproj = s_projects;
     while (currproj != NULL) {
-        walkfiles(currproj->str, syntax_audit);
+        inventory_walk(currproj->str, NULL, syntax_audit);
         currproj = (PathList*)currproj->next;
     }
     HeaderLinkList* header = s_header_links;
@@ -2199,7 +4858,7 @@ void audit() {
     if (s_easymemory_detected) {
         PathList* curr = s_projects;
         while (curr != NULL) {
-            walkfiles(curr->str, easyc_audit);
+            inventory_walk(curr->str, NULL, easyc_audit);
             curr = (PathList*)curr->next;
         }
     }
@@ -2236,20 +4895,896 @@ void port_folder(const char* path) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    s_max_argsc = argc;
-    initialize(argc, argv);
+uint64_t flag_signature() {
+    ArgList* command = calloc(1, sizeof(ArgList));
+    arglist_extend(command, s_defines, 0);
+    arglist_extend(command, s_includes, 0);
+    arglist_extend(command, s_raws, 1);
+    if (s_flags & PROD) arglist_add(command, "-DPROD_BUILD");
+    uint64_t signature = s_compiler_hash;
+    for (size_t i = 0; i < command->count; i++) {
+        signature = fnv1a_relocated(command->argv[i], strlen(command->argv[i]) + 1, s_cwd, signature);
+    }
+    arglist_delete(command);
+    return signature;
+}
+
+void add_to_archive(const char* file) {
+    size_t len = strlen(file);
+    if (len > 4 && strcmp(file + len - 4, ".tmp") == 0) return;
+    if (len > 2 && strcmp(file + len - 2, ".i") == 0) return;
+    if (strcmp(file, INVENTORY_PATH) == 0 || strcmp(file, STATE_PATH) == 0 ||
+        strcmp(file, DAEMON_SOCKET) == 0 || strcmp(file, LOCK_PATH) == 0) return;
+    pathlist_add(&s_archive_files, file);
+}
+
+int archive_member(const char* path) {
+    if (strstr(path, "..") != NULL) return 0;
+    return strncmp(path, "build/cache/", 12) == 0 ||
+           strncmp(path, "build/vendor/", 13) == 0 ||
+           strncmp(path, STORE_PATH "/", strlen(STORE_PATH) + 1) == 0;
+}
+
+void cache_export(const char* path) {
+    if (!fexists(MANIFEST_PATH)) {
+        crash("Nothing to export - build the project before exporting its cache");
+    }
+    walkfiles("build/cache", add_to_archive);
+    if (dexists("build/vendor")) walkfiles("build/vendor", add_to_archive);
+    if (dexists(STORE_PATH)) walkfiles(STORE_PATH, add_to_archive);
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        crash("Unable to write cache archive \"%s\"", path);
+    }
+    fprintf(out, "TINY CACHE %d\n%016" PRIx64 "\n", CACHE_ARCHIVE_VERSION, flag_signature());
+    size_t count = 0;
+    uint64_t bytes = 0;
+    char buffer[65536];
+    PathList* curr = s_archive_files;
+    while (curr != NULL) {
+        FileStats stats = { 0 };
+        FILE* fp = fopen(curr->str, "rb");
+        if (!fp || !filestats(curr->str, &stats)) {
+            crash("Unable to read \"%s\" for the cache archive", curr->str);
+        }
+        fprintf(out, "%" PRIu64 " %016" PRIx64 " %s\n", stats.size, hashfile(curr->str), curr->str);
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            if (fwrite(buffer, 1, read, out) != read) {
+                crash("Critical write error while exporting the cache");
+            }
+        }
+        fclose(fp);
+        count++;
+        bytes += stats.size;
+        curr = (PathList*)curr->next;
+    }
+    fprintf(out, "END %zu\n", count);
+    fclose(out);
+    pathlist_delete(s_archive_files);
+    s_archive_files = NULL;
+    int hours, minutes;
+    float seconds;
+    dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
+    print("\033[32mFinished\033[0m exporting %zu files (%.1f MB) to \"%s\" in %d:%d:%.3f", count, bytes / 1048576.0, path, hours, minutes, seconds);
+}
+
+void cache_import(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        crash("Unable to open cache archive \"%s\"", path);
+    }
+    char line[PATHLEN * 2] = { 0 };
+    int version = 0;
+    uint64_t signature = 0;
+    if (!fgets(line, sizeof(line), in) || sscanf(line, "TINY CACHE %d", &version) != 1 || version != CACHE_ARCHIVE_VERSION ||
+        !fgets(line, sizeof(line), in) || sscanf(line, "%" SCNx64, &signature) != 1) {
+        crash("\"%s\" is not a compatible tiny cache archive", path);
+    }
+    long records = ftell(in);
+    char buffer[65536];
+    size_t count = 0;
+    size_t expected = 0;
+    int matches = signature == flag_signature();
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            if (matches) {
+                if (dexists("build/cache")) rmtree("build/cache");
+                if (dexists("build/vendor")) rmtree("build/vendor");
+            } else {
+                warn("Cache archive was built with different flags or a different compiler - only importing its object store");
+            }
+            fseek(in, records, SEEK_SET);
+            count = 0;
+        }
+        while (fgets(line, sizeof(line), in)) {
+            if (sscanf(line, "END %zu", &expected) == 1) break;
+            uint64_t size = 0;
+            uint64_t hash = 0;
+            int offset = 0;
+            if (sscanf(line, "%" SCNu64 " %" SCNx64 " %n", &size, &hash, &offset) != 2) {
+                crash("Cache archive \"%s\" is corrupt - unreadable entry header", path);
+            }
+            char* member = line + offset;
+            member[strcspn(member, "\r\n")] = '\0';
+            FILE* out = NULL;
+            if (pass == 1 && archive_member(member) && (matches || strncmp(member, STORE_PATH "/", strlen(STORE_PATH) + 1) == 0)) {
+                char directory[PATHLEN] = { 0 };
+                strcpy(directory, member);
+                *strrchr(directory, '/') = '\0';
+                affirmdir(directory);
+                out = fopen(member, "wb");
+                if (!out) {
+                    crash("Unable to write \"%s\" while importing the cache", member);
+                }
+            } else if (pass == 1 && !archive_member(member)) {
+                warn("Skipping cache archive entry outside the build directory \"%s\"", member);
+            }
+            uint64_t actual = 0xcbf29ce484222325ULL;
+            uint64_t remaining = size;
+            while (remaining > 0) {
+                size_t chunk = remaining < sizeof(buffer) ? (size_t)remaining : sizeof(buffer);
+                if (fread(buffer, 1, chunk, in) != chunk) {
+                    crash("Cache archive \"%s\" is corrupt - \"%s\" is truncated", path, member);
+                }
+                if (pass == 0) actual = fnv1a(buffer, chunk, actual);
+                if (out) fwrite(buffer, 1, chunk, out);
+                remaining -= chunk;
+            }
+            if (out) fclose(out);
+            if (pass == 0 && actual != hash) {
+                crash("Cache archive \"%s\" is corrupt - checksum mismatch for \"%s\"", path, member);
+            }
+            count++;
+        }
+        if (expected != count) {
+            crash("Cache archive \"%s\" is corrupt - expected %zu entries but found %zu", path, expected, count);
+        }
+        if (pass == 1 && !matches) {
+            fclose(in);
+            print("\033[32mFinished\033[0m importing the object store from \"%s\"", path);
+            return;
+        }
+    }
+    fclose(in);
+    affirmdir("build/cache");
+    affirmdir("build/vendor");
+    manifest_load();
+    size_t valid = 0;
+    size_t dropped = 0;
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        HashEntry* he = &(s_manifest.entries[i]);
+        if (!he->key || !((ManifestEntry*)he->value)->recorded) continue;
+        ManifestEntry* entry = (ManifestEntry*)he->value;
+        FileStats current = { 0 };
+        if (filestats(he->key, &current) && hashview(he->key) == entry->hash) {
+            entry->stats = current;
+            valid++;
+        } else {
+            entry->recorded = 0;
+            entry->tracked = 0;
+            dropped++;
+        }
+    }
+    manifest_save();
+    int hours, minutes;
+    float seconds;
+    dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
+    print("\033[32mFinished\033[0m importing %zu files from \"%s\" in %d:%d:%.3f - %zu tracked files match, %zu will be rebuilt",
+        count, path, hours, minutes, seconds, valid, dropped);
+}
+
+uint64_t parsesize(const char* value) {
+    char* end = NULL;
+    double size = strtod(value, &end);
+    if (end == value || size <= 0) {
+        crash("Invalid cache size \"%s\" - expected a size such as \"512M\" or \"2G\"", value);
+    }
+    while (*end == ' ') end++;
+    if (*end == 'K' || *end == 'k') size *= 1024.0;
+    else if (*end == 'M' || *end == 'm') size *= 1024.0 * 1024.0;
+    else if (*end == 'G' || *end == 'g') size *= 1024.0 * 1024.0 * 1024.0;
+    else if (*end != '\0' && *end != 'B' && *end != 'b') {
+        crash("Invalid cache size \"%s\" - expected a size such as \"512M\" or \"2G\"", value);
+    }
+    return (uint64_t)size;
+}
+
+void add_live_object(const char* file) {
+    if (strstr(file, "build/cache") == &(file[0]) || strstr(file, "./build/cache") == &(file[0])) return;
+    size_t slen = strlen(file);
+    if (slen > 2 && (file[slen - 1] != 'c' || file[slen - 2] != '.')) return;
+    char object[PATHLEN] = { 0 };
+    object_path("build/cache", file, object);
+    hashmap_put(&s_live_objects, object, strdup(file));
+}
+
+void add_to_cache_files(const char* file) {
+    pathlist_add(&s_cache_files, file);
+}
+
+int compare_cache_files(const void* a, const void* b) {
+    const CacheFile* fa = (const CacheFile*)a;
+    const CacheFile* fb = (const CacheFile*)b;
+    if (fa->mtime != fb->mtime) return fa->mtime < fb->mtime ? -1 : 1;
+    return strcmp(fa->path, fb->path);
+}
+
+void cache_gc() {
+    uint64_t timer = mtime();
+    PathList* curr = s_projects;
+    while (curr != NULL) {
+        inventory_walk(curr->str, NULL, add_live_object);
+        curr = (PathList*)curr->next;
+    }
+    if (s_found_main) {
+        add_live_object(s_main_file_path);
+    } else if (fexists(s_main_file_name)) {
+        add_live_object(s_main_file_name);
+    }
+    curr = s_sources;
+    while (curr != NULL) {
+        char object[PATHLEN] = { 0 };
+        object_path("build/vendor", curr->str, object);
+        hashmap_put(&s_live_objects, object, strdup(curr->str));
+        curr = (PathList*)curr->next;
+    }
+    if (dexists("build/cache")) walkfiles("build/cache", add_to_cache_files);
+    if (dexists("build/vendor")) walkfiles("build/vendor", add_to_cache_files);
+    size_t orphans = 0;
+    uint64_t total = 0;
+    curr = s_cache_files;
+    while (curr != NULL) {
+        const char* file = curr->str;
+        char object[PATHLEN] = { 0 };
+        strcpy(object, file);
+        char* extension = strrchr(object, '.');
+        // only per-source outputs are collected, anything else in the cache belongs to someone else
+        int collected = extension != NULL && strchr(extension, '/') == NULL &&
+                        strncmp(file, "build/cache/pch/", 16) != 0 && strncmp(file, "build/cache/unity/", 18) != 0 &&
+                        (strcmp(extension, ".o") == 0 || strcmp(extension, ".d") == 0 ||
+                         strcmp(extension, ".log") == 0 || strcmp(extension, ".i") == 0);
+        if (collected) strcpy(extension, ".o");
+        FileStats stats = { 0 };
+        if (collected && !hashmap_get(&s_live_objects, object)) {
+            remove(file);
+            orphans++;
+        } else if (filestats(file, &stats)) {
+            total += stats.size;
+        }
+        curr = (PathList*)curr->next;
+    }
+    pathlist_delete(s_cache_files);
+    s_cache_files = NULL;
+    hashmap_clear(&s_live_objects, 1);
+    size_t forgotten = 0;
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        HashEntry* he = &(s_manifest.entries[i]);
+        if (!he->key || !((ManifestEntry*)he->value)->recorded || fexists(he->key)) continue;
+        ((ManifestEntry*)he->value)->recorded = 0;
+        ((ManifestEntry*)he->value)->tracked = 0;
+        forgotten++;
+    }
+    if (forgotten > 0) manifest_save();
+    if (dexists(STORE_PATH)) walkfiles(STORE_PATH, add_to_cache_files);
+    size_t count = pathlist_len(s_cache_files);
+    CacheFile* files = calloc(count + 1, sizeof(CacheFile));
+    size_t stored = 0;
+    curr = s_cache_files;
+    while (curr != NULL) {
+        size_t len = strlen(curr->str);
+        FileStats stats = { 0 };
+        if (filestats(curr->str, &stats)) {
+            total += stats.size;
+            if (len > 2 && strcmp(curr->str + len - 2, ".o") == 0) {
+                files[stored].path = curr->str;
+                files[stored].size = stats.size;
+                files[stored].mtime = stats.mtime;
+                stored++;
+            }
+        }
+        curr = (PathList*)curr->next;
+    }
+    pathlist_delete(s_cache_files);
+    s_cache_files = NULL;
+    size_t evicted = 0;
+    uint64_t freed = 0;
+    if (s_cache_limit > 0 && total > s_cache_limit) {
+        qsort(files, stored, sizeof(CacheFile), compare_cache_files);
+        for (size_t i = 0; i < stored && total > s_cache_limit; i++) {
+            char log[PATHLEN + 4] = { 0 };
+            snprintf(log, PATHLEN + 4, "%.*slog", (int)strlen(files[i].path) - 1, files[i].path);
+            FileStats stats = { 0 };
+            uint64_t size = files[i].size;
+            if (filestats(log, &stats)) size += stats.size;
+            remove(files[i].path);
+            remove(log);
+            total -= size < total ? size : total;
+            freed += size;
+            evicted++;
+        }
+    }
+    free(files);
+    int hours, minutes;
+    float seconds;
+    dissect_time_elapsed(timer, &hours, &minutes, &seconds);
+    print("\033[32mFinished\033[0m cache collection in %d:%d:%.3f - removed %zu orphaned files, forgot %zu deleted sources, evicted %zu stored objects (%.2f MB), cache is %.2f MB",
+        hours, minutes, seconds, orphans, forgotten, evicted, freed / 1048576.0, total / 1048576.0);
+}
+
+void cache_command(int argc, char* argv[]) {
+    s_start_time = mtime();
+    int gc = argc >= 3 && strcmp(argv[2], "gc") == 0;
+    if (!gc && (argc < 4 || (strcmp(argv[2], "export") != 0 && strcmp(argv[2], "import") != 0))) {
+        crash("Unknown cache command - expected \"tiny cache export <file>\", \"tiny cache import <file>\" or \"tiny cache gc\"");
+    }
+    for (int i = gc ? 3 : 4; i < argc; i++) {
+        parseflag(argv[i], 1);
+    }
+    prepare();
     integrate_modules();
-    affirm_projects();
-    if (s_flags & AUDIT) audit();
-    compile_vendors();
+    if (gc) {
+        affirm_projects();
+        manifest_load();
+        cache_gc();
+        return;
+    }
+    s_compiler_hash = compiler_hash();
+    if (strcmp(argv[2], "export") == 0) {
+        cache_export(argv[3]);
+    } else {
+        cache_import(argv[3]);
+    }
+    fileviews_close();
+}
+
+void build(int argc, char* argv[]) {
+    uint64_t traced = microtime();
+    if (s_flags & AUDIT) {
+        audit();
+        trace_phase("Auditing", traced);
+    }
+    traced = microtime();
     calculate_dependencies();
+    trace_phase("Calculating dependencies", traced);
+    traced = microtime();
     compile_objects();
-    if (!s_sources_up_to_date || !fexists("build/bin.exe") || !s_main_up_to_date || s_flags & RECOMPILE_VENDORS) {
+    trace_phase("Compiling sources", traced);
+    if (s_build_failed) {
+        print("Build \033[31mfailed\033[0m");
+    } else if (!s_sources_up_to_date || !fexists("build/bin.exe") || s_flags & RECOMPILE_VENDORS) {
+        traced = microtime();
         compile_executable();
+        trace_phase("Linking executable", traced);
+        s_relinked = !s_build_failed;
     } else {
         print("Current build is \033[32mup to date\033[0m, no need to build executable");
     }
+    if (s_cache_limit > 0 && !s_sources_up_to_date && !s_build_failed) {
+        traced = microtime();
+        cache_gc();
+        trace_phase("Collecting cache", traced);
+    }
+    if (!s_build_failed || (s_flags & WATCH)) state_save(argc, argv);
+    trace_phase("Build", s_trace_start);
+    trace_write();
+    if (s_flags & PROFILE) profile_write();
+    int hours, minutes;
+    float seconds;
+    dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
+    print("\033[32mFinished\033[0m total build in %d:%d:%.3f", hours, minutes, seconds);
+}
+
+void reset_build() {
+    s_start_time = mtime();
+    s_trace_start = microtime();
+    s_trace_count = 0;
+    s_profile_count = 0;
+    hashmap_clear(&s_profile_headers, 1);
+    s_build_failed = 0;
+    s_relinked = 0;
+    s_sources_up_to_date = 1;
+    s_main_scheduled = 0;
+    s_vulnerabilities = 0;
+    s_easymemory_detected = 0;
+    s_sourcei = 0;
+    pathlist_delete(s_objects);
+    pathlist_delete(s_changed_headers);
+    s_objects = NULL;
+    s_changed_headers = NULL;
+    for (size_t i = 0; i < s_dependents.capacity; i++) {
+        if (s_dependents.entries[i].key) pathlist_delete((PathList*)s_dependents.entries[i].value);
+    }
+    hashmap_clear(&s_dependents, 0);
+    hashmap_clear(&s_dirty, 0);
+    fileviews_close();
+
+    // forget what the last build learned about the tree so every input is checked again
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        if (!s_manifest.entries[i].key) continue;
+        ManifestEntry* entry = (ManifestEntry*)s_manifest.entries[i].value;
+        entry->status = MANIFEST_UNKNOWN;
+        entry->prefetched = 0;
+    }
+    for (size_t i = 0; i < s_inventory.capacity; i++) {
+        if (s_inventory.entries[i].key) ((InventoryDir*)s_inventory.entries[i].value)->scanned = 0;
+    }
+    s_inventory_ready = 0;
+    inventory_build();
+    PathList* curr = s_projects;
+    while (curr != NULL) {
+        inventory_walk(curr->str, affirm_to_cache, NULL);
+        curr = (PathList*)curr->next;
+    }
+    manifest_prefetch();
+}
+
+int config_changed() {
+    if (fexists(".tinyconf") != (hashmap_get(&s_watched_files, ".tinyconf") != NULL)) return 1;
+    for (size_t i = 0; i < s_watched_files.capacity; i++) {
+        HashEntry* he = &(s_watched_files.entries[i]);
+        if (!he->key) continue;
+        FileStats* recorded = (FileStats*)he->value;
+        FileStats current = { 0 };
+        if (!filestats(he->key, &current) || current.size != recorded->size ||
+            current.mtime != recorded->mtime || current.inode != recorded->inode) return 1;
+    }
+    // vendor directories are listed once at startup, the project root only matters for .tinyconf
+    for (size_t i = 0; i < s_watched_dirs.capacity; i++) {
+        HashEntry* he = &(s_watched_dirs.entries[i]);
+        if (!he->key || strcmp(he->key, ".") == 0) continue;
+        uint64_t current = 0;
+        if (!dirmtime(he->key, &current) || current != *(uint64_t*)he->value) return 1;
+    }
+    return 0;
+}
+
+void watch_targets(FileHandler func) {
+    HashMap seen = { 0 };
+    hashmap_put(&seen, ".", (void*)".");
+    func(".");
+    for (size_t i = 0; i < s_watched_dirs.capacity; i++) {
+        const char* dir = s_watched_dirs.entries[i].key;
+        if (dir && !hashmap_get(&seen, dir)) {
+            hashmap_put(&seen, dir, (void*)dir);
+            func(dir);
+        }
+    }
+    for (size_t i = 0; i < s_inventory.capacity; i++) {
+        HashEntry* he = &(s_inventory.entries[i]);
+        if (he->key && ((InventoryDir*)he->value)->scanned && !hashmap_get(&seen, he->key)) {
+            hashmap_put(&seen, he->key, (void*)he->key);
+            func(he->key);
+        }
+    }
+    // headers can live anywhere an include path or a dependency points
+    char parent[PATHLEN] = { 0 };
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        const char* path = s_manifest.entries[i].key;
+        if (!path || strncmp(path, "build/cache/", 12) == 0) continue;
+        strcpy(parent, path);
+        char* sep = strrchr(parent, '/');
+        if (sep == NULL) continue;
+        *sep = '\0';
+        if (!hashmap_get(&seen, parent) && dexists(parent)) {
+            hashmap_put(&seen, parent, (void*)intern(parent));
+            func(parent);
+        }
+    }
+    PathList* include = s_includes;
+    while (include != NULL) {
+        const char* dir = include->str + 2;
+        if (!hashmap_get(&seen, dir) && dexists(dir)) {
+            hashmap_put(&seen, dir, (void*)dir);
+            func(dir);
+        }
+        include = (PathList*)include->next;
+    }
+    hashmap_clear(&seen, 0);
+}
+
+void watch(int argc, char* argv[]) {
+    s_flags &= ~RECOMPILE_VENDORS;
+    if ((s_flags & RUN) && !s_build_failed) launch_build();
+    while (1) {
+        print("Watching for changes...");
+        watch_wait(argc, argv);
+        if (config_changed()) {
+            print("Configuration changed, restarting...");
+            stop_build();
+            restart_self(argv);
+        }
+        build_lock();
+        reset_build();
+        build(argc, argv);
+        build_unlock();
+        if ((s_flags & RUN) && s_relinked) {
+            stop_build();
+            launch_build();
+        }
+    }
+}
+
+uint64_t request_signature(int argc, char* argv[]) {
+    uint64_t signature = 0xcbf29ce484222325ULL;
+    for (int i = 1; i < argc; i++) {
+        // run arguments belong to the client, which launches the executable itself
+        size_t length = strcspn(argv[i], "=");
+        if ((length == 2 && strncmp(argv[i], "-r", 2) == 0) || (length == 4 && strncmp(argv[i], "-run", 4) == 0)) break;
+        if (strcmp(argv[i], "--daemon") == 0 || strcmp(argv[i], "-daemon") == 0) continue;
+        signature = fnv1a(argv[i], strlen(argv[i]) + 1, signature);
+    }
+    return signature;
+}
+
+void manifest_reload() {
+    for (size_t i = 0; i < s_manifest.capacity; i++) {
+        if (s_manifest.entries[i].key) pathlist_delete(((ManifestEntry*)s_manifest.entries[i].value)->deps);
+    }
+    hashmap_clear(&s_manifest, 1);
+    manifest_load();
+}
+
+int daemon_request(int argc, char* argv[], int request_argc, char* request_argv[]) {
+    s_start_time = mtime();
+    if (request_signature(request_argc, request_argv) != request_signature(argc, argv)) {
+        print("Build daemon is serving different flags, building locally...");
+        return DAEMON_REFUSED;
+    }
+    if (config_changed()) {
+        print("Configuration changed, restarting the build daemon...");
+        return DAEMON_RESTART;
+    }
+    // the in-memory manifest and inventory describe a cache that "tiny -c" or an import replaced
+    if (!fexists(MANIFEST_PATH)) {
+        print("Build cache was cleaned, restarting the build daemon...");
+        return DAEMON_RESTART;
+    }
+    // refused clients take the build lock themselves, it is only held here for builds served by the daemon
+    build_lock();
+    if (state_fresh(request_argc, request_argv)) {
+        int hours, minutes;
+        float seconds;
+        dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
+        print("Current build is \033[32mup to date\033[0m, no need to build executable");
+        print("\033[32mFinished\033[0m total build in %d:%d:%.3f", hours, minutes, seconds);
+        build_unlock();
+        return 0;
+    }
+    // a build that bypassed the daemon leaves a newer manifest behind
+    FileStats manifest = { 0 };
+    if (filestats(MANIFEST_PATH, &manifest) && (manifest.size != s_daemon_manifest.size ||
+        manifest.mtime != s_daemon_manifest.mtime || manifest.inode != s_daemon_manifest.inode)) {
+        manifest_reload();
+    }
+    reset_build();
+    build(request_argc, request_argv);
+    filestats(MANIFEST_PATH, &s_daemon_manifest);
+    build_unlock();
+    return s_build_failed;
+}
+
+TraceEvent* trace_push() {
+    if (s_trace_count == s_trace_capacity) {
+        s_trace_capacity = s_trace_capacity ? s_trace_capacity * 2 : 256;
+        s_trace_events = realloc(s_trace_events, s_trace_capacity * sizeof(TraceEvent));
+    }
+    TraceEvent* event = &(s_trace_events[s_trace_count++]);
+    memset(event, 0, sizeof(TraceEvent));
+    return event;
+}
+
+void trace_phase(const char* name, uint64_t start) {
+    if (s_trace_path[0] == '\0') return;
+    uint64_t now = microtime();
+    TINY_LOCK_MUTEX(s_trace_mutex);
+    TraceEvent* event = trace_push();
+    event->name = name;
+    event->category = "phase";
+    event->start = start;
+    event->duration = now - start;
+    event->cached = -1;
+    TINY_RELEASE_MUTEX(s_trace_mutex);
+}
+
+void trace_job(CompileJob* job, uint64_t start, int cached) {
+    if (s_trace_path[0] == '\0') return;
+    uint64_t now = microtime();
+    const char* file = intern(job->file);
+    TINY_LOCK_MUTEX(s_trace_mutex);
+    TraceEvent* event = trace_push();
+    event->name = file + job->basename_ptr;
+    event->file = file;
+    event->category = strncmp(job->object, "build/vendor/", 13) == 0 ? "vendor" :
+                      strncmp(job->object, "build/cache/unity/", 18) == 0 ? "unity" : "compile";
+    event->start = start;
+    event->duration = now - start;
+    event->queued = job->queued && job->queued < start ? start - job->queued : 0;
+    event->lane = job->lane;
+    event->cached = cached;
+    TINY_RELEASE_MUTEX(s_trace_mutex);
+}
+
+void trace_string(FILE* fp, const char* str) {
+    fputc('"', fp);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(fp, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void trace_write() {
+    if (s_trace_path[0] == '\0') return;
+    FILE* fp = fopen(s_trace_path, "w");
+    if (!fp) {
+        warn("Unable to write build trace \"%s\"", s_trace_path);
+        return;
+    }
+    // complete events on one lane per worker, loadable in chrome://tracing and Perfetto
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tiny\"}}");
+    fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}");
+    for (int i = 1; i <= s_thread_count; i++) {
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", i, i);
+    }
+    for (size_t i = 0; i < s_trace_count; i++) {
+        TraceEvent* event = &(s_trace_events[i]);
+        fprintf(fp, ",\n{\"name\":");
+        trace_string(fp, event->name);
+        fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"pid\":1,\"tid\":%d",
+                event->category, event->start - s_trace_start, event->duration, event->lane);
+        if (event->file != NULL) {
+            fprintf(fp, ",\"args\":{\"file\":");
+            trace_string(fp, event->file);
+            fprintf(fp, ",\"cached\":%s,\"queued_us\":%" PRIu64 "}", event->cached ? "true" : "false", event->queued);
+        }
+        fputc('}', fp);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+}
+
+int profile_phase(const char* name) {
+    for (int i = 0; i < PROFILE_PHASES; i++) {
+        if (s_profile_phases[i] == NULL) {
+            s_profile_phases[i] = intern(name);
+            return i;
+        }
+        if (strcmp(s_profile_phases[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+void profile_collect(CompileJob* job, const char* log, uint64_t duration) {
+    FILE* fp = fopen(log, "r");
+    if (!fp) return;
+    char filtered[PATHLEN + 8] = { 0 };
+    snprintf(filtered, PATHLEN + 8, "%s.tmp", log);
+    FILE* out = fopen(filtered, "w");
+    if (!out) {
+        crash("Unable to filter compile profile output for \"%s\"", job->file);
+    }
+    if (s_profile_count == s_profile_capacity) {
+        s_profile_capacity = s_profile_capacity ? s_profile_capacity * 2 : 64;
+        s_profile_units = realloc(s_profile_units, s_profile_capacity * sizeof(ProfileUnit));
+    }
+    ProfileUnit* unit = &(s_profile_units[s_profile_count++]);
+    memset(unit, 0, sizeof(ProfileUnit));
+    unit->file = intern(job->file);
+    unit->wall = duration;
+    size_t count = 0;
+    size_t capacity = 64;
+    const char** headers = malloc(capacity * sizeof(char*));
+    int* depths = malloc(capacity * sizeof(int));
+    int timing = 0;
+    int guards = 0;
+    char line[PATHLEN * 2] = { 0 };
+    char path[PATHLEN] = { 0 };
+    while (fgets(line, sizeof(line), fp)) {
+        size_t length = strcspn(line, "\r\n");
+        int dots = 0;
+        while (line[dots] == '.') dots++;
+        snprintf(path, PATHLEN, "%.*s", (int)length, line);
+        if (timing) {
+            // gcc -ftime-report rows are "name : usr (pct) sys (pct) wall (pct) ggc"
+            char* colon = strchr(line, ':');
+            double usr = 0, sys = 0, wall = 0;
+            if (strncmp(line, " TOTAL", 6) == 0) {
+                timing = 0;
+                if (colon && sscanf(colon + 1, " %lf %lf %lf", &usr, &sys, &wall) == 3) unit->total = wall * 1000;
+            } else if (strncmp(line, " phase ", 7) == 0 && colon && sscanf(colon + 1, " %lf ( %*d%%) %lf ( %*d%%) %lf", &usr, &sys, &wall) == 3) {
+                char* end = colon;
+                while (end > line + 7 && end[-1] == ' ') end--;
+                *end = '\0';
+                int phase = profile_phase(line + 7);
+                if (phase >= 0) unit->phases[phase] = wall * 1000;
+            }
+        } else if (length == 0 || strncmp(line, "Time variable", 13) == 0) {
+            timing = length > 0;
+        } else if (strncmp(line, "Multiple include guards may be useful for:", 42) == 0) {
+            guards = 1;
+        } else if (guards && fexists(path)) {
+            continue;
+        } else if (dots > 0 && line[dots] == ' ') {
+            if (count == capacity) {
+                capacity *= 2;
+                headers = realloc(headers, capacity * sizeof(char*));
+                depths = realloc(depths, capacity * sizeof(int));
+            }
+            headers[count] = intern(path + dots + 1);
+            depths[count] = dots;
+            count++;
+        } else if ((line[0] == '!' || line[0] == 'x') && line[1] == ' ' && fexists(path + 2)) {
+            // precompiled headers that were used or rejected
+            continue;
+        } else {
+            guards = 0;
+            fputs(line, out);
+        }
+    }
+    fclose(fp);
+    fclose(out);
+    replacefile(filtered, log);
+    // a unit's parsing time is shared out by the size of everything it reads, and a header
+    // is charged for itself plus the headers nested under it
+    FileStats stats = { 0 };
+    uint64_t total = filestats(job->file, &stats) ? stats.size : 0;
+    uint64_t* bytes = malloc((count + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++) {
+        ProfileHeader* header = (ProfileHeader*)hashmap_get(&s_profile_headers, headers[i]);
+        if (header == NULL) {
+            header = calloc(1, sizeof(ProfileHeader));
+            header->bytes = filestats(headers[i], &stats) ? stats.size : 0;
+            header->last_unit = (size_t)-1;
+            header->last_direct = (size_t)-1;
+            hashmap_put(&s_profile_headers, headers[i], header);
+        }
+        bytes[i] = header->bytes;
+        total += header->bytes;
+    }
+    int parsing = profile_phase("parsing");
+    double parse = parsing >= 0 ? unit->phases[parsing] : 0;
+    for (size_t i = 0; i < count; i++) {
+        ProfileHeader* header = (ProfileHeader*)hashmap_get(&s_profile_headers, headers[i]);
+        uint64_t inclusive = bytes[i];
+        for (size_t j = i + 1; j < count && depths[j] > depths[i]; j++) inclusive += bytes[j];
+        if (total > 0) header->parse += parse * inclusive / total;
+        if (header->last_unit != s_profile_count - 1) {
+            header->last_unit = s_profile_count - 1;
+            header->units++;
+        }
+        if (depths[i] == 1 && header->last_direct != s_profile_count - 1) {
+            header->last_direct = s_profile_count - 1;
+            header->direct++;
+        }
+    }
+    free(bytes);
+    free(headers);
+    free(depths);
+}
+
+int compare_profile_units(const void* a, const void* b) {
+    uint64_t wa = ((const ProfileUnit*)a)->wall;
+    uint64_t wb = ((const ProfileUnit*)b)->wall;
+    return wa < wb ? 1 : wa > wb ? -1 : 0;
+}
+
+int compare_profile_headers(const void* a, const void* b) {
+    double pa = ((const ProfileHeader*)hashmap_get(&s_profile_headers, *(const char**)a))->parse;
+    double pb = ((const ProfileHeader*)hashmap_get(&s_profile_headers, *(const char**)b))->parse;
+    return pa < pb ? 1 : pa > pb ? -1 : strcmp(*(const char**)a, *(const char**)b);
+}
+
+void profile_write() {
+    FILE* fp = fopen(PROFILE_PATH, "w");
+    if (!fp) {
+        warn("Unable to write compile profile \"%s\"", PROFILE_PATH);
+        return;
+    }
+    qsort(s_profile_units, s_profile_count, sizeof(ProfileUnit), compare_profile_units);
+    uint64_t wall = 0;
+    for (size_t i = 0; i < s_profile_count; i++) wall += s_profile_units[i].wall;
+    fprintf(fp, "Tiny compile profile - %zu translation units, %.3fs of compile time\n\n", s_profile_count, wall / 1000000.0);
+    fprintf(fp, "Time per translation unit in ms (measured wall time, then gcc -ftime-report wall time by phase)\n\n");
+    fprintf(fp, "%10s %10s", "wall", "gcc total");
+    for (int i = 0; i < PROFILE_PHASES && s_profile_phases[i]; i++) {
+        fprintf(fp, " %*s", (int)(strlen(s_profile_phases[i]) > 9 ? strlen(s_profile_phases[i]) : 9), s_profile_phases[i]);
+    }
+    fprintf(fp, "  unit\n");
+    for (size_t i = 0; i < s_profile_count; i++) {
+        ProfileUnit* unit = &(s_profile_units[i]);
+        fprintf(fp, "%10.1f %10.1f", unit->wall / 1000.0, unit->total);
+        for (int j = 0; j < PROFILE_PHASES && s_profile_phases[j]; j++) {
+            fprintf(fp, " %*.1f", (int)(strlen(s_profile_phases[j]) > 9 ? strlen(s_profile_phases[j]) : 9), unit->phases[j]);
+        }
+        fprintf(fp, "  %s\n", unit->file);
+    }
+    const char** headers = malloc((s_profile_headers.count + 1) * sizeof(char*));
+    size_t count = 0;
+    for (size_t i = 0; i < s_profile_headers.capacity; i++) {
+        if (s_profile_headers.entries[i].key) headers[count++] = s_profile_headers.entries[i].key;
+    }
+    qsort(headers, count, sizeof(char*), compare_profile_headers);
+    fprintf(fp, "\nHeaders by parse time added in ms (each unit's parsing phase shared out by the size of what it reads,\n");
+    fprintf(fp, "counting the headers nested under each one) and by how many units include them, directly or at all\n\n");
+    fprintf(fp, "%10s %8s %8s  %s\n", "parse", "units", "direct", "header");
+    for (size_t i = 0; i < count; i++) {
+        ProfileHeader* header = (ProfileHeader*)hashmap_get(&s_profile_headers, headers[i]);
+        fprintf(fp, "%10.1f %8zu %8zu  %s\n", header->parse, header->units, header->direct, headers[i]);
+    }
+    free(headers);
+    fclose(fp);
+    print("Compile profile of %zu units written to \"%s\"", s_profile_count, PROFILE_PATH);
+}
+
+int main(int argc, char* argv[]) {
+    s_max_argsc = argc;
+    TINY_CREATE_MUTEX(s_arena_mutex);
+    TINY_CREATE_MUTEX(s_view_mutex);
+    TINY_CREATE_MUTEX(s_trace_mutex);
+    if (argc > 1 && strcmp(argv[1], "cache") == 0) {
+        build_lock();
+        cache_command(argc, argv);
+        return 0;
+    }
+    parseflags(argc, argv);
+    // the daemon never runs the executable itself, only a FLAG run from .tinyconf is passed on to clients
+    if (s_flags & DAEMON) {
+        s_flags &= ~RUN;
+        s_daemon_fd = daemon_listen();
+    }
+    if (!(s_flags & (WATCH | DAEMON))) {
+        int status = daemon_forward(argc, argv);
+        if (status != DAEMON_REFUSED) {
+            if (status == 0 && (s_flags & RUN)) {
+                run_build();
+            }
+            for (int i = 0; i < s_copy_argsc; i++) {
+                free(s_copy_argsv[i]);
+            }
+            if (s_copy_argsv) free(s_copy_argsv);
+            return status;
+        }
+    }
+    build_lock();
+    if (!(s_flags & DAEMON) && state_fresh(argc, argv)) {
+        trace_phase("Checking build state", s_trace_start);
+        trace_write();
+        int hours, minutes;
+        float seconds;
+        dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
+        print("Current build is \033[32mup to date\033[0m, no need to build executable");
+        print("\033[32mFinished\033[0m total build in %d:%d:%.3f", hours, minutes, seconds);
+        build_unlock();
+        if (s_flags & RUN) {
+            run_build();
+        }
+        for (int i = 0; i < s_copy_argsc; i++) {
+            free(s_copy_argsv[i]);
+        }
+        if (s_copy_argsv) free(s_copy_argsv);
+        return 0;
+    }
+    initialize();
+    integrate_modules();
+    affirm_projects();
+    if ((s_flags & DAEMON) && (s_flags & WATCH)) {
+        crash("Watch mode cannot be combined with the build daemon");
+    }
+    build(argc, argv);
+    build_unlock();
+    if (s_flags & DAEMON) {
+        s_flags &= ~RECOMPILE_VENDORS;
+        filestats(MANIFEST_PATH, &s_daemon_manifest);
+        daemon_serve(argc, argv);
+    }
+    if (s_flags & WATCH) watch(argc, argv);
     pathlist_delete(s_sources);
     pathlist_delete(s_includes);
     pathlist_delete(s_links);
@@ -2257,14 +5792,12 @@ int main(int argc, char* argv[]) {
     pathlist_delete(s_libs);
     pathlist_delete(s_raws);
     pathlist_delete(s_projects);
-    int hours, minutes;
-    float seconds;
-    dissect_time_elapsed(s_start_time, &hours, &minutes, &seconds);
-    print("\033[32mFinished\033[0m total build in %d:%d:%.3f", hours, minutes, seconds);
-    if (s_flags & FAST) {
-        free(s_threads);
-        free(s_active_threads);
+    for (int i = 0; i < 2; i++) {
+        if (s_compile_templates[i]) arglist_delete(s_compile_templates[i]);
     }
+    if (s_base_template) arglist_delete(s_base_template);
+    fileviews_close();
+    pool_stop();
     if (s_flags & RUN) {
         run_build();
     }